@@ -0,0 +1,42 @@
+/*
+ * \brief  Client-side GPU session interface
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+#ifndef _INCLUDE__GPU_SESSION__CLIENT_H_
+#define _INCLUDE__GPU_SESSION__CLIENT_H_
+
+#include <base/rpc_client.h>
+#include <gpu_session/gpu_session.h>
+
+namespace Gpu { struct Session_client; }
+
+struct Gpu::Session_client : Genode::Rpc_client<Session>
+{
+	explicit Session_client(Genode::Capability<Session> session)
+	: Genode::Rpc_client<Session>(session) { }
+
+	Genode::Ram_dataspace_capability alloc_buffer(size_t size) override {
+		return call<Rpc_alloc_buffer>(size); }
+
+	void free_buffer(Genode::Ram_dataspace_capability ds) override {
+		call<Rpc_free_buffer>(ds); }
+
+	void map_buffer(Genode::Ram_dataspace_capability ds, addr_t ga, bool writeable) override {
+		call<Rpc_map_buffer>(ds, ga, writeable); }
+
+	void unmap_buffer(Genode::Ram_dataspace_capability ds) override {
+		call<Rpc_unmap_buffer>(ds); }
+
+	Seqno exec_buffer(addr_t ga) override {
+		return call<Rpc_exec_buffer>(ga); }
+
+	Seqno completed() override {
+		return call<Rpc_completed>(); }
+
+	void completion_sigh(Genode::Signal_context_capability sigh) override {
+		call<Rpc_completion_sigh>(sigh); }
+};
+
+#endif /* _INCLUDE__GPU_SESSION__CLIENT_H_ */
@@ -0,0 +1,58 @@
+/*
+ * \brief  Connection to GPU service
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+#ifndef _INCLUDE__GPU_SESSION__CONNECTION_H_
+#define _INCLUDE__GPU_SESSION__CONNECTION_H_
+
+#include <base/connection.h>
+#include <util/retry.h>
+#include <util/string.h>
+#include <gpu_session/client.h>
+
+namespace Gpu { struct Connection; }
+
+struct Gpu::Connection : Genode::Connection<Session>, Session_client
+{
+	private:
+
+		Genode::Env &_env;
+
+		void _upgrade(size_t amount)
+		{
+			char quota[32];
+			Genode::snprintf(quota, sizeof(quota), "ram_quota=%ld", amount);
+			_env.parent().upgrade(cap(), quota);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param ram_quota  quota donated up front, covers the session's
+		 *                   metadata and initial buffers
+		 */
+		Connection(Genode::Env &env, size_t ram_quota = 64*1024, char const *label = "")
+		:
+			Genode::Connection<Session>(env, session(env.parent(),
+			                                         "ram_quota=%ld, label=\"%s\"",
+			                                         ram_quota, label)),
+			Session_client(cap()),
+			_env(env)
+		{ }
+
+		/**
+		 * Allocate buffer, upgrading the session by its size if needed
+		 */
+		Genode::Ram_dataspace_capability alloc_buffer(size_t size) override
+		{
+			return Genode::retry<Session::Out_of_metadata>(
+				[&] () { return Session_client::alloc_buffer(size); },
+				[&] () { _upgrade(size); });
+		}
+};
+
+#endif /* _INCLUDE__GPU_SESSION__CONNECTION_H_ */
@@ -0,0 +1,122 @@
+/*
+ * \brief  GPU session interface
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+/*
+ * Every session owns a GPU context with its own PPGTT and ring. Clients
+ * allocate buffers, map them into the PPGTT of their context and execute
+ * batch buffers from it. Batches of a session complete in order, each one
+ * is identified by the sequence number returned on execution.
+ *
+ * Buffers are accounted to the session's RAM quota. Graphics addresses
+ * below RESERVED_SIZE are used by the multiplexer and cannot be mapped.
+ */
+
+#ifndef _INCLUDE__GPU_SESSION__GPU_SESSION_H_
+#define _INCLUDE__GPU_SESSION__GPU_SESSION_H_
+
+#include <base/exception.h>
+#include <base/signal.h>
+#include <ram_session/ram_session.h>
+#include <session/session.h>
+
+namespace Gpu {
+
+	using Genode::size_t;
+	using Genode::addr_t;
+	using Genode::uint32_t;
+
+	struct Session;
+}
+
+struct Gpu::Session : Genode::Session
+{
+	static const char *service_name() { return "Gpu"; }
+
+	enum { RESERVED_SIZE = 0x10000 };
+
+	typedef uint32_t Seqno;
+
+	class Out_of_metadata : public Genode::Exception { };
+	class Invalid_buffer  : public Genode::Exception { };
+	class Ring_full       : public Genode::Exception { };
+
+	virtual ~Session() { }
+
+	/**
+	 * Allocate buffer of DMA memory
+	 *
+	 * \throw Out_of_metadata  session quota does not cover the buffer
+	 */
+	virtual Genode::Ram_dataspace_capability alloc_buffer(size_t size) = 0;
+
+	/**
+	 * Unmap and free buffer
+	 *
+	 * The memory is reused only after all batches executed so far
+	 * completed. The call does not wait for that.
+	 */
+	virtual void free_buffer(Genode::Ram_dataspace_capability ds) = 0;
+
+	/**
+	 * Map buffer to page-aligned graphics address 'ga'
+	 *
+	 * \throw Invalid_buffer  unknown buffer, buffer already mapped, or
+	 *                        address range reserved or in use
+	 */
+	virtual void map_buffer(Genode::Ram_dataspace_capability ds, addr_t ga,
+	                        bool writeable) = 0;
+
+	/**
+	 * Unmap buffer
+	 *
+	 * The range stays in use until all batches executed so far completed.
+	 * The call does not wait for that.
+	 */
+	virtual void unmap_buffer(Genode::Ram_dataspace_capability ds) = 0;
+
+	/**
+	 * Execute batch buffer at graphics address 'ga'
+	 *
+	 * \throw Invalid_buffer  'ga' does not point into a mapped buffer
+	 * \throw Ring_full       too many batches pending
+	 *
+	 * \return  sequence number of the batch
+	 */
+	virtual Seqno exec_buffer(addr_t ga) = 0;
+
+	/**
+	 * Sequence number of the last completed batch
+	 */
+	virtual Seqno completed() = 0;
+
+	/**
+	 * Register signal handler notified on completion of batches
+	 */
+	virtual void completion_sigh(Genode::Signal_context_capability sigh) = 0;
+
+
+	/*******************
+	 ** RPC interface **
+	 *******************/
+
+	GENODE_RPC_THROW(Rpc_alloc_buffer, Genode::Ram_dataspace_capability, alloc_buffer,
+	                 GENODE_TYPE_LIST(Out_of_metadata), size_t);
+	GENODE_RPC(Rpc_free_buffer, void, free_buffer, Genode::Ram_dataspace_capability);
+	GENODE_RPC_THROW(Rpc_map_buffer, void, map_buffer,
+	                 GENODE_TYPE_LIST(Invalid_buffer),
+	                 Genode::Ram_dataspace_capability, addr_t, bool);
+	GENODE_RPC(Rpc_unmap_buffer, void, unmap_buffer, Genode::Ram_dataspace_capability);
+	GENODE_RPC_THROW(Rpc_exec_buffer, Seqno, exec_buffer,
+	                 GENODE_TYPE_LIST(Invalid_buffer, Ring_full), addr_t);
+	GENODE_RPC(Rpc_completed, Seqno, completed);
+	GENODE_RPC(Rpc_completion_sigh, void, completion_sigh, Genode::Signal_context_capability);
+
+	GENODE_RPC_INTERFACE(Rpc_alloc_buffer, Rpc_free_buffer, Rpc_map_buffer,
+	                     Rpc_unmap_buffer, Rpc_exec_buffer, Rpc_completed,
+	                     Rpc_completion_sigh);
+};
+
+#endif /* _INCLUDE__GPU_SESSION__GPU_SESSION_H_ */
@@ -0,0 +1,27 @@
+/*
+ * \brief  Checks of the driver tests
+ * \author Alexander Senier
+ * \date   2017-02-06
+ */
+
+#ifndef _INCLUDE__TEST__CHECK_H_
+#define _INCLUDE__TEST__CHECK_H_
+
+#include <base/log.h>
+
+namespace Test {
+
+	/**
+	 * Log failed check
+	 *
+	 * \return  'condition', to be accumulated over all checks of a test
+	 */
+	inline bool check(bool condition, char const *what)
+	{
+		if (!condition)
+			Genode::error("FAILED: ", what);
+		return condition;
+	}
+}
+
+#endif /* _INCLUDE__TEST__CHECK_H_ */
@@ -0,0 +1,146 @@
+/*
+ * \brief  Hash index from address ranges to elements
+ * \author Alexander Senier
+ * \date   2017-01-19
+ */
+
+#ifndef _ADDRESS_INDEX_H_
+#define _ADDRESS_INDEX_H_
+
+#include <base/allocator.h>
+#include <base/tslab.h>
+#include <util/string.h>
+
+namespace Genode {
+
+	template <typename ELEMENT> class Address_index;
+}
+
+/*
+ * An element is registered for every granule of 2^GRANULE_LOG2 bytes it
+ * overlaps. Thus, interior pointers are found by hashing the granule they
+ * are located in, without searching. The bucket array is doubled once the
+ * average chain length exceeds two nodes.
+ */
+template <typename ELEMENT>
+class Genode::Address_index
+{
+	private:
+
+		struct Node
+		{
+			addr_t               granule;
+			addr_t               base;
+			size_t               size;
+			ELEMENT             *element;
+			Node                *next;
+		};
+
+		enum { INITIAL_BUCKETS_LOG2 = 8 };
+
+		Allocator    &_alloc;
+		Tslab<Node, 4096> _nodes;
+
+		unsigned  const _granule_log2;
+		unsigned        _buckets_log2 = INITIAL_BUCKETS_LOG2;
+		Node          **_buckets;
+		size_t          _count = 0;
+
+		static Node **_alloc_buckets(Allocator &alloc, unsigned log2)
+		{
+			Node **buckets = (Node **)alloc.alloc(sizeof(Node *) << log2);
+			memset(buckets, 0, sizeof(Node *) << log2);
+			return buckets;
+		}
+
+		size_t _index(addr_t granule) const
+		{
+			return (granule * 0x9e3779b97f4a7c15ULL) >> (64 - _buckets_log2);
+		}
+
+		void _grow()
+		{
+			unsigned const old_log2    = _buckets_log2;
+			Node   **const old_buckets = _buckets;
+
+			_buckets_log2 = old_log2 + 1;
+			_buckets      = _alloc_buckets(_alloc, _buckets_log2);
+
+			for (size_t i = 0; i < (1UL << old_log2); i++) {
+				while (Node *n = old_buckets[i]) {
+					old_buckets[i] = n->next;
+					n->next = _buckets[_index(n->granule)];
+					_buckets[_index(n->granule)] = n;
+				}
+			}
+
+			_alloc.free(old_buckets, sizeof(Node *) << old_log2);
+		}
+
+		template <typename FUNC>
+		void _for_each_granule(addr_t base, size_t size, FUNC const &fn)
+		{
+			addr_t const first = base >> _granule_log2;
+			addr_t const last  = (base + size - 1) >> _granule_log2;
+
+			for (addr_t g = first; g <= last; g++)
+				fn (g);
+		}
+
+	public:
+
+		Address_index(Allocator &alloc, unsigned granule_log2)
+		:
+			_alloc(alloc), _nodes(&alloc), _granule_log2(granule_log2),
+			_buckets(_alloc_buckets(alloc, INITIAL_BUCKETS_LOG2))
+		{ }
+
+		~Address_index()
+		{
+			_alloc.free(_buckets, sizeof(Node *) << _buckets_log2);
+		}
+
+		void insert(addr_t base, size_t size, ELEMENT *element)
+		{
+			_for_each_granule(base, size, [&] (addr_t granule) {
+				Node *n = new (&_nodes) Node { granule, base, size, element,
+				                               _buckets[_index(granule)] };
+				_buckets[_index(granule)] = n;
+				_count++;
+			});
+
+			if (_count > (2UL << _buckets_log2))
+				_grow();
+		}
+
+		void remove(addr_t base, size_t size, ELEMENT *element)
+		{
+			_for_each_granule(base, size, [&] (addr_t granule) {
+				for (Node **n = &_buckets[_index(granule)]; *n; n = &(*n)->next) {
+					if ((*n)->element == element && (*n)->granule == granule) {
+						Node *r = *n;
+						*n = r->next;
+						destroy(&_nodes, r);
+						_count--;
+						return;
+					}
+				}
+			});
+		}
+
+		/**
+		 * Look up element containing 'addr'
+		 */
+		ELEMENT *lookup(addr_t addr) const
+		{
+			addr_t const granule = addr >> _granule_log2;
+
+			for (Node *n = _buckets[_index(granule)]; n; n = n->next)
+				if (n->granule == granule && addr - n->base < n->size)
+					return n->element;
+
+			return nullptr;
+		}
+};
+
+#endif /* _ADDRESS_INDEX_H_ */
@@ -0,0 +1,202 @@
+/*
+ * \brief  Batch buffer builder
+ * \author Alexander Senier
+ * \date   2017-01-27
+ */
+
+/*
+ * Commands are emitted as their typed instruction objects, whose encoding
+ * is folded into constants by the compiler. Emitting a command is a copy
+ * of the object plus a single check for the end of the current page.
+ *
+ * A batch consists of pages at consecutive graphics addresses. When a page
+ * is full, the builder chains to the next one, adding a page the first time
+ * the batch grows that large:
+ *
+ * - The first page is executed as first-level batch. It calls the second
+ *   page as second-level batch, which returns to the MI_BATCH_BUFFER_END
+ *   following the call.
+ * - Every further page chains to its successor by another second-level
+ *   MI_BATCH_BUFFER_START.
+ * - The last page is closed by MI_BATCH_BUFFER_END, which returns to the
+ *   first page.
+ *
+ * Every page reserves space for the call and MI_BATCH_BUFFER_END. Pages are
+ * kept on 'reset', so rebuilding a batch of the same size does not allocate
+ * or map anything.
+ */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <base/exception.h>
+#include <submission.h>
+#include <instructions.h>
+
+namespace Genode {
+
+	class Batch;
+}
+
+class Genode::Batch
+{
+	public:
+
+		enum { PAGE_SIZE = 4096, MAX_PAGES = 64 };
+
+		class Too_large : public Genode::Exception { };
+
+	private:
+
+		enum {
+			RESERVED = sizeof (Mi_batch_buffer_start) + sizeof (Mi_batch_buffer_end),
+			LIMIT    = PAGE_SIZE - RESERVED
+		};
+
+		Translation_table_allocator &_allocator;
+		Submission                  &_submission;
+		addr_t const                 _ga;
+
+		Genode::uint8_t *_pages[MAX_PAGES] = { };
+		unsigned         _count   = 0;
+		unsigned         _current = 0;
+
+		Genode::uint8_t *_cursor = nullptr;
+		Genode::uint8_t *_limit  = nullptr;
+
+		Page_flags const _flags = Page_flags
+			{ .writeable  = false,
+			  .executable = true,
+			  .privileged = true,
+			  .global     = false,
+			  .device     = false,
+			  .cacheable  = UNCACHED };
+
+		addr_t _page_ga(unsigned page) const { return _ga + page * PAGE_SIZE; }
+
+		addr_t _page_pa(unsigned page) const {
+			return (addr_t)_allocator.phys_addr (_pages[page]); }
+
+		void _select(unsigned page)
+		{
+			_current = page;
+			_cursor  = _pages[page];
+			_limit   = _cursor + LIMIT;
+		}
+
+		void _add_page()
+		{
+			if (_count == MAX_PAGES)
+				throw Too_large();
+
+			_pages[_count] = (Genode::uint8_t *)_allocator.alloc (PAGE_SIZE);
+			_submission.insert_translation (_page_ga (_count), _page_pa (_count),
+			                                PAGE_SIZE, _flags);
+			_count++;
+		}
+
+		template <typename CMD>
+		void _write(CMD const &cmd)
+		{
+			*(CMD *)_cursor = cmd;
+			_cursor += sizeof (CMD);
+		}
+
+		/*
+		 * Continue the batch on the next page
+		 */
+		void _chain()
+		{
+			unsigned const next = _current + 1;
+			if (next == _count)
+				_add_page();
+
+			int const level = Mi_batch_buffer_start::Header::Second_level_batch_buffer::SECOND_LEVEL_BATCH;
+			int const as    = Mi_batch_buffer_start::Header::Address_space_indicator::PPGTT;
+
+			_write (Mi_batch_buffer_start (_page_ga (next), level, as));
+
+			/* The second-level chain returns to the first page */
+			if (_current == 0)
+				_write (Mi_batch_buffer_end());
+
+			_select (next);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param submission  context whose PPGTT maps the batch
+		 * \param ga          graphics address of the batch, pages are
+		 *                    mapped consecutively from there on
+		 */
+		Batch(Translation_table_allocator &allocator, Submission &submission, addr_t ga)
+		:
+			_allocator (allocator), _submission (submission), _ga (ga)
+		{
+			_add_page();
+			_select (0);
+		}
+
+		~Batch()
+		{
+			for (unsigned i = 0; i < _count; i++) {
+				_submission.remove_translation (_page_ga (i), PAGE_SIZE);
+				_allocator.free (_pages[i], PAGE_SIZE);
+			}
+		}
+
+		/**
+		 * Append command
+		 *
+		 * \throw Too_large  batch exceeds MAX_PAGES
+		 */
+		template <typename CMD>
+		void emit(CMD const &cmd)
+		{
+			static_assert (sizeof (CMD) % 8 == 0, "Command not QWord aligned");
+			static_assert (sizeof (CMD) <= LIMIT, "Command exceeds batch page");
+
+			if (_cursor + sizeof (CMD) > _limit)
+				_chain();
+
+			_write (cmd);
+		}
+
+		/**
+		 * Close batch with MI_BATCH_BUFFER_END
+		 *
+		 * Commands emitted afterwards replace the MI_BATCH_BUFFER_END.
+		 *
+		 * \return  graphics address to be executed as first-level batch
+		 */
+		addr_t end()
+		{
+			*(Mi_batch_buffer_end *)_cursor = Mi_batch_buffer_end();
+			return _ga;
+		}
+
+		/**
+		 * Start a new batch on the same pages
+		 *
+		 * The GPU must have completed the previous batch.
+		 */
+		void reset() { _select (0); }
+
+		/**
+		 * Call 'fn(ga, pa)' for every page, e.g., to map the batch into
+		 * further contexts
+		 */
+		template <typename FUNC>
+		void for_each_page(FUNC const &fn) const
+		{
+			for (unsigned i = 0; i < _count; i++)
+				fn (_page_ga (i), _page_pa (i));
+		}
+
+		unsigned pages() const { return _count; }
+};
+
+#endif /* _BATCH_H_ */
@@ -0,0 +1,154 @@
+/*
+ * \brief  Pool of batch buffers recycled by completion fences
+ * \author Alexander Senier
+ * \date   2017-01-27
+ */
+
+/*
+ * Every batch of the pool owns a fixed window of graphics addresses in the
+ * PPGTT of the submission. Its pages stay mapped for the lifetime of the
+ * pool. A submitted batch is returned to the free list once the fence of
+ * the submission passed its sequence number, so after warm-up, building and
+ * submitting a batch neither allocates memory nor updates page tables.
+ *
+ * Jobs of a submission complete in order, so in-flight batches are kept in
+ * submission order and only the oldest one needs to be checked.
+ */
+
+#ifndef _BATCH_POOL_H_
+#define _BATCH_POOL_H_
+
+#include <util/fifo.h>
+#include <base/allocator.h>
+#include <batch.h>
+
+namespace Genode {
+
+	class Batch_pool;
+}
+
+class Genode::Batch_pool
+{
+	public:
+
+		/* Graphics address range reserved for each batch */
+		enum { WINDOW_SIZE = Batch::MAX_PAGES * Batch::PAGE_SIZE };
+
+	private:
+
+		struct Entry : Batch, Fifo<Entry>::Element
+		{
+			Genode::uint32_t seqno = 0;
+
+			Entry(Translation_table_allocator &allocator, Submission &submission, addr_t ga)
+			: Batch (allocator, submission, ga) { }
+		};
+
+		Translation_table_allocator &_allocator;
+		Allocator                   &_md_alloc;
+		Submission                  &_submission;
+		addr_t const                 _ga;
+		unsigned const               _max;
+
+		Fifo<Entry> _free;
+		Fifo<Entry> _busy;
+		unsigned    _count = 0;
+
+		/*
+		 * Move completed batches to the free list
+		 */
+		void _reclaim()
+		{
+			while (Entry *e = _busy.head()) {
+
+				if (!_submission.fence().signaled (e->seqno))
+					break;
+
+				_busy.dequeue();
+				_free.enqueue (e);
+			}
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param submission  context executing the batches
+		 * \param ga          graphics address of the first batch window
+		 * \param max         maximum number of batches
+		 */
+		Batch_pool(Translation_table_allocator &allocator, Allocator &md_alloc,
+		           Submission &submission, addr_t ga, unsigned max)
+		:
+			_allocator (allocator), _md_alloc (md_alloc),
+			_submission (submission), _ga (ga), _max (max)
+		{ }
+
+		/**
+		 * Destructor
+		 *
+		 * The submission must have completed all batches.
+		 */
+		~Batch_pool()
+		{
+			_reclaim();
+			while (Entry *e = _free.dequeue())
+				destroy (&_md_alloc, e);
+			while (Entry *e = _busy.dequeue())
+				destroy (&_md_alloc, e);
+		}
+
+		/**
+		 * Get empty batch
+		 *
+		 * \return  nullptr if all batches are in flight
+		 */
+		Batch *alloc()
+		{
+			_reclaim();
+
+			Entry *e = _free.dequeue();
+			if (!e && _count < _max) {
+				e = new (&_md_alloc) Entry (_allocator, _submission, _ga + _count * WINDOW_SIZE);
+				_count++;
+			}
+
+			if (!e)
+				return nullptr;
+
+			e->reset();
+			return e;
+		}
+
+		/**
+		 * Close batch and insert it into the ring of the submission
+		 *
+		 * The submission still needs to be committed to the GPU.
+		 *
+		 * \return  false if the ring is full, the batch stays with the
+		 *          caller and may be submitted again
+		 */
+		bool submit(Batch &batch)
+		{
+			if (!_submission.insert (batch.end()))
+				return false;
+
+			Entry &e = static_cast<Entry &>(batch);
+			e.seqno = _submission.seqno();
+			_busy.enqueue (&e);
+			return true;
+		}
+
+		/**
+		 * Return batch that was not submitted
+		 */
+		void free(Batch &batch) { _free.enqueue (&static_cast<Entry &>(batch)); }
+
+		/**
+		 * Number of batches created so far
+		 */
+		unsigned batches() const { return _count; }
+};
+
+#endif /* _BATCH_POOL_H_ */
@@ -0,0 +1,232 @@
+/*
+ * \brief  Copy and fill offload to the blitter engine
+ * \author Alexander Senier
+ * \date   2017-01-24
+ */
+
+/*
+ * Clearing and copying uncached DMA memory with the CPU stalls on every
+ * store. The blitter engine (BCS) instead copies and fills memory
+ * asynchronously. Completion is signaled by the fence of the blitter's
+ * submission, so callers can wait for a particular operation or continue
+ * with other work. The fence is written by the post-sync write of the
+ * MI_FLUSH_DW that follows every batch, i.e., after the blits reached
+ * memory.
+ *
+ * Operations are linear byte ranges, which are blitted as rectangles of 32 bit
+ * pixels: full rows of ROW_SIZE bytes first, then a single row with the
+ * remainder. Every operation is written to a slot of the batch buffer, which
+ * ends with MI_BATCH_BUFFER_END. A slot is reused once the fence passed the
+ * sequence number of the operation that used it last.
+ *
+ * Memory is identity-mapped into the PPGTT of the blitter context, i.e. the
+ * graphics address of a buffer is its physical address.
+ */
+
+#ifndef _BLITTER_H_
+#define _BLITTER_H_
+
+#include <submission.h>
+#include <scheduler.h>
+#include <instructions.h>
+
+namespace Genode {
+
+	class Blitter;
+}
+
+class Genode::Blitter
+{
+	public:
+
+		enum {
+			ROW_SIZE   = 16384,
+			SLOT_SIZE  = 256,
+			BATCH_SIZE = 4096,
+			SLOTS      = BATCH_SIZE / SLOT_SIZE,
+		};
+
+	private:
+
+		/* PPGTT address of the batch buffer, above all physical memory */
+		enum { BATCH_GA = 1UL << 40 };
+
+		enum { PIXEL_SIZE = 4, MAX_ROWS = 0xffff, PAGE_SIZE_LOG2 = 12 };
+
+		/* Every operation consists of up to two blits */
+		static_assert (2 * sizeof (Xy_src_copy_blt) + sizeof (Mi_batch_buffer_end) <= SLOT_SIZE &&
+		               2 * sizeof (Xy_color_blt)    + sizeof (Mi_batch_buffer_end) <= SLOT_SIZE,
+		               "Batch slot too small");
+
+		Submission          _submission;
+		Execlist_scheduler &_scheduler;
+
+		Genode::uint8_t    *_batch;
+		Genode::uint32_t    _slot_seqno[SLOTS] = { };
+		unsigned            _next_slot = 0;
+
+		Page_flags const _flags = Page_flags
+			{ .writeable  = true,
+			  .executable = false,
+			  .privileged = true,
+			  .global     = false,
+			  .device     = false,
+			  .cacheable  = UNCACHED };
+
+		/*
+		 * Mapped ranges are remembered, so that buffers used repeatedly
+		 * are not mapped again
+		 */
+		enum { MAPPED = 16 };
+		struct Range { addr_t base; size_t size; } _mapped[MAPPED] = { };
+		unsigned _next_mapped = 0;
+
+		void _map(addr_t pa, size_t size)
+		{
+			addr_t const base = pa & ~((1UL << PAGE_SIZE_LOG2) - 1);
+			size = align_addr (pa + size, PAGE_SIZE_LOG2) - base;
+
+			for (Range const &r : _mapped)
+				if (r.size && base >= r.base && base + size <= r.base + r.size)
+					return;
+
+			_submission.insert_translation (base, base, size, _flags);
+			_mapped[_next_mapped] = Range { base, size };
+			_next_mapped = (_next_mapped + 1) % MAPPED;
+		}
+
+		/*
+		 * Call 'fn(dst_offset, rows, row_size)' for every rectangle of a
+		 * linear range
+		 */
+		template <typename FUNC>
+		static void _for_each_rect(size_t size, FUNC const &fn)
+		{
+			size_t const rows = size / ROW_SIZE;
+			if (rows)
+				fn (0UL, rows, (size_t)ROW_SIZE);
+
+			if (size % ROW_SIZE)
+				fn (rows * ROW_SIZE, 1UL, size % ROW_SIZE);
+		}
+
+		/*
+		 * Write commands of one operation into a free batch slot, insert it
+		 * and submit the blitter context
+		 */
+		template <typename FUNC>
+		bool _submit(FUNC const &fn, Genode::uint32_t &seqno)
+		{
+			unsigned const slot = _next_slot;
+
+			if (!_submission.fence().signaled (_slot_seqno[slot]))
+				return false;
+
+			Genode::uint8_t *cmd = _batch + slot * SLOT_SIZE;
+			fn (cmd);
+			*(Mi_batch_buffer_end *)cmd = Mi_batch_buffer_end();
+
+			if (!_submission.insert (BATCH_GA + slot * SLOT_SIZE))
+				return false;
+
+			_next_slot        = (slot + 1) % SLOTS;
+			_slot_seqno[slot] = seqno = _submission.seqno();
+
+			_scheduler.submit (_submission);
+			return true;
+		}
+
+		static void _check(size_t size)
+		{
+			assert (size % PIXEL_SIZE == 0);
+			assert (size / ROW_SIZE <= MAX_ROWS);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param scheduler  scheduler of the blitter engine
+		 * \param id         context ID of the blitter context
+		 */
+		Blitter(Translation_table_allocator &allocator, Context_pool &pool, IGD &igd,
+		        Execlist_scheduler &scheduler, unsigned id)
+		:
+			_submission (&allocator, pool, igd, BCS, 16, id),
+			_scheduler (scheduler),
+			_batch ((Genode::uint8_t *)allocator.alloc (BATCH_SIZE))
+		{
+			assert (scheduler.engine() == BCS);
+
+			Page_flags const batch_flags = Page_flags
+				{ .writeable  = false,
+				  .executable = true,
+				  .privileged = true,
+				  .global     = false,
+				  .device     = false,
+				  .cacheable  = UNCACHED };
+
+			_submission.insert_translation (BATCH_GA, (addr_t)allocator.phys_addr (_batch),
+			                                BATCH_SIZE, batch_flags);
+		}
+
+		/**
+		 * Fill 'size' bytes at physical address 'pa' with 'value'
+		 *
+		 * \param seqno  sequence number signaled by the fence on completion
+		 *
+		 * \return  false if all batch slots are in use
+		 */
+		bool fill(addr_t pa, size_t size, Genode::uint32_t value, Genode::uint32_t &seqno)
+		{
+			_check (size);
+			_map (pa, size);
+
+			return _submit ([&] (Genode::uint8_t *&cmd) {
+				_for_each_rect (size, [&] (size_t offset, size_t rows, size_t row_size) {
+					*(Xy_color_blt *)cmd = Xy_color_blt (pa + offset, ROW_SIZE,
+					                                     row_size / PIXEL_SIZE, rows, value);
+					cmd += sizeof (Xy_color_blt);
+				});
+			}, seqno);
+		}
+
+		/**
+		 * Copy 'size' bytes from physical address 'src' to 'dst'
+		 *
+		 * \param seqno  sequence number signaled by the fence on completion
+		 *
+		 * \return  false if all batch slots are in use
+		 */
+		bool copy(addr_t dst, addr_t src, size_t size, Genode::uint32_t &seqno)
+		{
+			_check (size);
+			_map (dst, size);
+			_map (src, size);
+
+			return _submit ([&] (Genode::uint8_t *&cmd) {
+				_for_each_rect (size, [&] (size_t offset, size_t rows, size_t row_size) {
+					*(Xy_src_copy_blt *)cmd = Xy_src_copy_blt (dst + offset, src + offset, ROW_SIZE,
+					                                           row_size / PIXEL_SIZE, rows);
+					cmd += sizeof (Xy_src_copy_blt);
+				});
+			}, seqno);
+		}
+
+		/**
+		 * Fence signaled by completed operations
+		 */
+		Fence const &fence() const { return _submission.fence(); }
+
+		/**
+		 * Busy-wait for completion of the operation with sequence number
+		 * 'seqno' for at most 'cycles' timestamp counter ticks
+		 *
+		 * \return  false if the operation did not complete in time
+		 */
+		bool wait(Genode::uint32_t seqno, Trace::Timestamp cycles) const {
+			return fence().wait (seqno, cycles); }
+};
+
+#endif /* _BLITTER_H_ */
@@ -0,0 +1,265 @@
+/*
+ * \brief  Wait for context completion
+ * \author Alexander Senier
+ * \date   2017-01-16
+ */
+
+/*
+ * Completion is detected by processing the context status buffers of all
+ * engines. Three modes are supported:
+ *
+ * - poll:   spin on the hardware status page until all contexts completed
+ *           or the timeout expired, then poll it periodically from a timer
+ * - irq:    block on the context switch interrupt
+ * - hybrid: spin for a short time and then block on the interrupt
+ *
+ * Short jobs complete within the spin period without interrupt latency,
+ * while long jobs do not burn a CPU. Blocking is implemented by returning to
+ * the entrypoint, which dispatches the IRQ signal handler.
+ *
+ * The mode is selected by the 'completion' node of the component's config:
+ *
+ * <config>
+ * 	<completion mode="hybrid" spin_us="50" timeout_ms="1000" poll_us="1000"/>
+ * </config>
+ *
+ * Without interrupts, the timer poll is what processes context status
+ * events after 'wait' returned, e.g., preemptions or completions of
+ * batches submitted outside of 'wait'.
+ */
+
+#ifndef _COMPLETION_H_
+#define _COMPLETION_H_
+
+#include <base/log.h>
+#include <base/signal.h>
+#include <base/trace/timestamp.h>
+#include <irq_session/client.h>
+#include <timer_session/connection.h>
+#include <util/xml_node.h>
+
+#include <igd.h>
+#include <scheduler.h>
+#include <context_status.h>
+
+namespace Genode {
+
+	class Completion;
+}
+
+class Genode::Completion
+{
+	public:
+
+		enum Mode { POLL, IRQ, HYBRID };
+
+		struct Handler
+		{
+			virtual void context_event(Engine, Context_status_buffer::Event const &) = 0;
+
+			/**
+			 * All contexts completed
+			 */
+			virtual void idle() = 0;
+		};
+
+	private:
+
+		IGD                &_igd;
+		Execlist_scheduler *_schedulers[NUM_ENGINES] = { };
+		Handler            &_handler;
+		Irq_session_client  _irq;
+
+		Signal_handler<Completion> _irq_handler;
+
+		Timer::Connection          _poll_timer;
+		Signal_handler<Completion> _poll_handler;
+
+		Mode               _mode       = HYBRID;
+		unsigned long      _spin_us    = 50;
+		unsigned long      _timeout_ms = 1000;
+		unsigned long      _poll_us    = 1000;
+		Trace::Timestamp   _tsc_per_us;
+
+		bool               _waiting = false;
+
+		/*
+		 * Number of interrupts handled and completions detected while
+		 * spinning
+		 */
+		unsigned long _irqs     = 0;
+		unsigned long _spins    = 0;
+		unsigned long _timeouts = 0;
+
+		/* Error register at the last interrupt, only changes are traced */
+		uint32_t _errors = 0;
+
+		static Trace::Timestamp _calibrate(Timer::Connection &timer)
+		{
+			enum { CALIBRATION_US = 10000 };
+
+			Trace::Timestamp const start = Trace::timestamp();
+			timer.usleep (CALIBRATION_US);
+			return (Trace::timestamp() - start) / CALIBRATION_US;
+		}
+
+		void _process()
+		{
+			for (Execlist_scheduler *s : _schedulers)
+				if (s)
+					s->process ([&] (Context_status_buffer::Event const &e) {
+						_handler.context_event (s->engine(), e); });
+		}
+
+		bool _idle()
+		{
+			for (Execlist_scheduler *s : _schedulers)
+				if (s && !s->idle())
+					return false;
+			return true;
+		}
+
+		void _complete()
+		{
+			_waiting = false;
+			_handler.idle();
+		}
+
+		void _handle_irq()
+		{
+			_irqs++;
+
+			_igd.clear_interrupts();
+
+			/* Reading the error register costs an uncached MMIO read */
+			if (event_trace().enabled()) {
+				uint32_t const errors = _igd.errors();
+				if (errors != _errors)
+					event_trace().record (Event_trace::FAULT, Event_trace::NO_ENGINE,
+					                      0, errors);
+				_errors = errors;
+			}
+
+			_process();
+			_irq.ack_irq();
+
+			if (_waiting && _idle())
+				_complete();
+		}
+
+		void _handle_poll()
+		{
+			_process();
+
+			if (_waiting && _idle())
+				_complete();
+		}
+
+		/*
+		 * Spin on the hardware status page
+		 *
+		 * \return  true if all contexts completed within the spin period
+		 */
+		bool _spin(Trace::Timestamp const cycles)
+		{
+			Trace::Timestamp const start = Trace::timestamp();
+
+			while (!_idle()) {
+
+				_process();
+
+				if (cycles && Trace::timestamp() - start > cycles)
+					return false;
+			}
+
+			_spins++;
+			return true;
+		}
+
+	public:
+
+		Completion(Env                    &env,
+		           IGD                    &igd,
+		           Handler                &handler,
+		           Irq_session_capability  irq,
+		           Timer::Connection      &timer,
+		           Xml_node                config)
+		:
+			_igd (igd), _handler (handler), _irq (irq),
+			_irq_handler (env.ep(), *this, &Completion::_handle_irq),
+			_poll_timer (env),
+			_poll_handler (env.ep(), *this, &Completion::_handle_poll),
+			_tsc_per_us (_calibrate (timer))
+		{
+			try {
+				Xml_node node = config.sub_node ("completion");
+
+				String<16> const mode = node.attribute_value ("mode", String<16>("hybrid"));
+				if (mode == "poll") _mode = POLL;
+				if (mode == "irq")  _mode = IRQ;
+
+				_spin_us    = node.attribute_value ("spin_us", _spin_us);
+				_timeout_ms = node.attribute_value ("timeout_ms", _timeout_ms);
+				_poll_us    = node.attribute_value ("poll_us", _poll_us);
+			} catch (Xml_node::Nonexistent_sub_node) { }
+
+			_irq.sigh (_irq_handler);
+			_irq.ack_irq();
+
+			if (_mode != POLL) {
+				_igd.enable_interrupts();
+				return;
+			}
+
+			_poll_timer.sigh (_poll_handler);
+			_poll_timer.trigger_periodic (_poll_us);
+		}
+
+		/**
+		 * Wait for completions of the engine scheduled by 'scheduler'
+		 */
+		void add(Execlist_scheduler &scheduler)
+		{
+			_schedulers[scheduler.engine()] = &scheduler;
+		}
+
+		/**
+		 * Wait for all submitted contexts to complete
+		 *
+		 * In irq and hybrid mode the call may return before completion.
+		 * The handler's 'idle' method is called once all contexts
+		 * completed. In poll mode, the call stops spinning after the
+		 * timeout, e.g., if the GPU hangs, and leaves the completion to the
+		 * timer poll.
+		 */
+		void wait()
+		{
+			_waiting = true;
+
+			switch (_mode) {
+			case POLL:
+				if (!_spin (_timeout_ms * 1000 * _tsc_per_us)) {
+					_timeouts++;
+					error ("timeout waiting for context completion");
+					return;
+				}
+				break;
+			case HYBRID: _spin (_spin_us * _tsc_per_us); break;
+			case IRQ:    _process(); break;
+			}
+
+			if (_idle())
+				_complete();
+		}
+
+		unsigned long irqs()     const { return _irqs; }
+		unsigned long spins()    const { return _spins; }
+		unsigned long timeouts() const { return _timeouts; }
+
+		/**
+		 * Timestamp counter rate as calibrated on construction
+		 */
+		Trace::Timestamp tsc_per_us() const { return _tsc_per_us; }
+};
+
+#endif /* _COMPLETION_H_ */
@@ -39,13 +39,19 @@
 
 #include <util/register.h>
 #include <instructions.h>
+#include <engine.h>
 
 namespace Genode {
 
-	template <Genode::addr_t RING_BASE> class Ring_context;
-	template <Genode::addr_t RING_BASE> class PPGTT_context;
+	class Ring_context;
+	class PPGTT_context;
+	class Execlist_context;
 	class Rcs_misc_context;
-	class Rcs_context;
+	struct No_misc_context;
+	struct From_golden_image { };
+	template <typename MISC, bool = MISC::HAS_IMAGE> struct Lri_image;
+	template <Engine ENGINE> struct Context_layout;
+	template <Engine ENGINE> class Engine_context;
 
 	struct Common_register : Register<64>
 	{
@@ -65,13 +71,41 @@ namespace Genode {
 		       Opaque_register::Data::bits(0);
 	};
 
+	/*
+	 * Compile-time counterpart of 'Bitfield::bits' used for golden images
+	 */
+	template <typename FIELD>
+	constexpr Genode::uint64_t golden_bits(Genode::uint64_t value)
+	{
+		return (value & ((1ULL << FIELD::WIDTH) - 1)) << FIELD::SHIFT;
+	}
+
+	/*
+	 * LRI register entry at 'offset' from 'ring_base' holding 'value'
+	 */
+	constexpr Genode::uint64_t golden_reg(addr_t ring_base, unsigned offset,
+	                                      Genode::uint64_t value = 0)
+	{
+		return golden_bits<Common_register::Mmio_offset>(ring_base + offset) | value;
+	}
+
 	/*
 	 * Number of pages to be used as  GuC shared data page in context.
 	 */
 	enum { GUC_SHARED_PAGES = 1 };
 }
 
-template <Genode::addr_t RING_BASE>
+/*
+ * Golden context images
+ *
+ * The LRI blocks of a new context only differ in the ring address, the ring
+ * length and PDP0. Every LRI block therefore provides a plain 'Image' of
+ * its layout and a constexpr 'golden' image with these fields set to zero.
+ * A context is initialized by copying the golden image of its engine and
+ * patching the per-context fields. The constructors taking all fields are
+ * kept as reference, the golden_context test checks that both match.
+ */
+
 class Genode::Ring_context
 {
 	private:
@@ -167,7 +201,58 @@ class Genode::Ring_context
 		Mi_noop					_noop_2[2];
 
 	public:
-		Ring_context(addr_t ring_address,
+
+		/*
+		 * Layout of the ring context as plain data
+		 */
+		struct Image
+		{
+			Genode::uint64_t noop_1;
+			Genode::uint32_t load_register_immediate_header;
+			Genode::uint64_t registers[14];
+			Genode::uint64_t noop_2[2];
+		};
+
+		/*
+		 * Ring context without ring address and length
+		 *
+		 * An MI_NOOP is all zeroes.
+		 */
+		static constexpr Image golden(addr_t ring_base)
+		{
+			return Image {
+				0, 0x1100101b,
+				{
+					golden_reg(ring_base, 0x244,
+					           golden_bits<Context_control::Engine_context_restore_inhibit>(1) |
+					           golden_bits<Context_control::Rs_context_enable>(1) |
+					           golden_bits<Context_control::Inhibit_syn_context_switch>(1)),
+					golden_reg(ring_base, 0x34),
+					golden_reg(ring_base, 0x30),
+					golden_reg(ring_base, 0x38),
+					golden_reg(ring_base, 0x3c,
+					           golden_bits<Ring_buffer_control::Arhp>(Ring_buffer_control::Arhp::MI_AUTOREPORT_OFF) |
+					           golden_bits<Ring_buffer_control::Ring_buffer_enable>(1)),
+					golden_reg(ring_base, 0x168),
+					golden_reg(ring_base, 0x140),
+					golden_reg(ring_base, 0x110),
+					golden_reg(ring_base, 0x11c),
+					golden_reg(ring_base, 0x114),
+					golden_reg(ring_base, 0x118),
+					golden_reg(ring_base, 0x1c0),
+					golden_reg(ring_base, 0x1c4),
+					golden_reg(ring_base, 0x1c8)
+				},
+				{ 0, 0 } };
+		}
+
+		/**
+		 * Constructor leaving the fields to a golden image
+		 */
+		Ring_context(From_golden_image) { }
+
+		Ring_context(addr_t ring_base,
+			     addr_t ring_address,
 			     size_t ring_length,
 			     addr_t bb_per_ctx_addr = 0,
 			     addr_t ind_cs_ctx_addr = 0,
@@ -176,75 +261,93 @@ class Genode::Ring_context
 		:
 			_load_register_immediate_header(0x1100101b),
 
-			_context_control(Common_register::Mmio_offset::bits(RING_BASE + 0x244) |
+			_context_control(Common_register::Mmio_offset::bits(ring_base + 0x244) |
 					 Context_control::Engine_context_restore_inhibit::bits(1) |
 					 Context_control::Rs_context_enable::bits(1) |
 					 Context_control::Inhibit_syn_context_switch::bits(1)),
 
-			_ring_head_pointer_register(Common_register::Mmio_offset::bits(RING_BASE + 0x34) |
+			_ring_head_pointer_register(Common_register::Mmio_offset::bits(ring_base + 0x34) |
 						    Ring_buffer_head::Wrap_count::bits(0) |
 						    Ring_buffer_head::Head_offset::bits(0) |
 						    Ring_buffer_head::Reserved_mbz::bits(0)),
 
-			_ring_tail_pointer_register(Common_register::Mmio_offset::bits(RING_BASE + 0x30) |
+			_ring_tail_pointer_register(Common_register::Mmio_offset::bits(ring_base + 0x30) |
 						    Ring_buffer_tail::Reserved_mbz_1::bits(0) |
 						    Ring_buffer_tail::Tail_offset::bits(0) |
 						    Ring_buffer_tail::Reserved_mbz_2::bits(0)),
 
-			_ring_buffer_start(Common_register::Mmio_offset::bits(RING_BASE + 0x38) |
-					   Ring_buffer_start::Starting_address::bits(ring_address) |
+			_ring_buffer_start(Common_register::Mmio_offset::bits(ring_base + 0x38) |
+					   Ring_buffer_start::Starting_address::bits(ring_address >> 12) |
 				           Ring_buffer_start::Reserved_mbz::bits(0)),
 
-			_ring_buffer_control(Common_register::Mmio_offset::bits(RING_BASE + 0x3c) |
+			_ring_buffer_control(Common_register::Mmio_offset::bits(ring_base + 0x3c) |
 					     Ring_buffer_control::Reserved_mbz_1::bits(0) |
-					     Ring_buffer_control::Buffer_length::bits(ring_length) |
+					     Ring_buffer_control::Buffer_length::bits((ring_length >> 12) - 1) |
 					     Ring_buffer_control::RBwait::bits(0) |
 					     Ring_buffer_control::Semaphore_wait::bits(0) |
 					     Ring_buffer_control::Reserved_mbz_2::bits(0) |
 					     Ring_buffer_control::Arhp::bits(Ring_buffer_control::Arhp::MI_AUTOREPORT_OFF) |
 					     Ring_buffer_control::Ring_buffer_enable::bits(1)),
 
-			_batch_buffer_current_head_register_udw(DEFAULT_OPAQUE_REG(RING_BASE, 0x168)),
-			_batch_buffer_current_head_register(DEFAULT_OPAQUE_REG(RING_BASE, 0x140)),
-			_batch_buffer_state_register(DEFAULT_OPAQUE_REG(RING_BASE, 0x110)),
-			_second_bb_addr_udw(DEFAULT_OPAQUE_REG(RING_BASE, 0x11c)),
-			_second_bb_addr(DEFAULT_OPAQUE_REG(RING_BASE, 0x114)),
-			_second_bb_state(DEFAULT_OPAQUE_REG(RING_BASE, 0x118)),
+			_batch_buffer_current_head_register_udw(DEFAULT_OPAQUE_REG(ring_base, 0x168)),
+			_batch_buffer_current_head_register(DEFAULT_OPAQUE_REG(ring_base, 0x140)),
+			_batch_buffer_state_register(DEFAULT_OPAQUE_REG(ring_base, 0x110)),
+			_second_bb_addr_udw(DEFAULT_OPAQUE_REG(ring_base, 0x11c)),
+			_second_bb_addr(DEFAULT_OPAQUE_REG(ring_base, 0x114)),
+			_second_bb_state(DEFAULT_OPAQUE_REG(ring_base, 0x118)),
 
-			_bb_per_ctx_ptr(Common_register::Mmio_offset::bits(RING_BASE + 0x1c0) |
+			_bb_per_ctx_ptr(Common_register::Mmio_offset::bits(ring_base + 0x1c0) |
 					Bb_per_ctx_ptr::Address::bits(bb_per_ctx_addr) |
 					Bb_per_ctx_ptr::Reserved_mbz::bits(0) |
 					Bb_per_ctx_ptr::Enable::bits(0) |
 					Bb_per_ctx_ptr::Valid::bits(bb_per_ctx_addr ? 1 : 0)),
 
-			_vcs_indirect_ctx(Common_register::Mmio_offset::bits(RING_BASE + 0x1c4) |
+			_vcs_indirect_ctx(Common_register::Mmio_offset::bits(ring_base + 0x1c4) |
 					  Indirect_ctx_ptr::Address::bits(ind_cs_ctx_addr) |
 					  Indirect_ctx_ptr::Size::bits(ind_cs_ctx_size)),
 
-			_vcs_indirect_ctx_offset(Common_register::Mmio_offset::bits(RING_BASE + 0x1c8) |
+			_vcs_indirect_ctx_offset(Common_register::Mmio_offset::bits(ring_base + 0x1c8) |
 						 Indirect_ctx_offset::Reserved_mbz_1::bits(0) |
 						 Indirect_ctx_offset::Offset::bits(ind_cs_ctx_off) |
 						 Indirect_ctx_offset::Reserved_mbz_2::bits(0))
 		{
 		};
 
+		/*
+		 * Head and tail offsets are byte offsets into the ring buffer. The
+		 * head is written by the GPU when the context is saved.
+		 */
+
 		size_t tail_offset()
 		{
-			return Ring_buffer_tail::Tail_offset::get(_ring_tail_pointer_register);
+			return Ring_buffer_tail::Tail_offset::masked(_ring_tail_pointer_register);
 		}
 
 		void tail_offset(size_t offset)
 		{
-			Ring_buffer_tail::Tail_offset::set(_ring_tail_pointer_register, offset);
+			Ring_buffer_tail::Tail_offset::set(_ring_tail_pointer_register,
+			                                   offset >> Ring_buffer_tail::Tail_offset::SHIFT);
 		}
 
 		size_t head_offset()
 		{
-			return Ring_buffer_head::Head_offset::get(_ring_head_pointer_register);
+			typename Ring_buffer_head::access_t const volatile *head = &_ring_head_pointer_register;
+			return Ring_buffer_head::Head_offset::masked(*head);
+		}
+
+		/*
+		 * Set ring address and length of a golden image
+		 */
+		void ring(addr_t ring_address, size_t ring_length)
+		{
+			Ring_buffer_start::Starting_address::set(_ring_buffer_start, ring_address >> 12);
+			Ring_buffer_control::Buffer_length::set(_ring_buffer_control, (ring_length >> 12) - 1);
 		}
 };
 
-template <Genode::addr_t RING_BASE>
+static_assert (sizeof (Genode::Ring_context::Image) == sizeof (Genode::Ring_context),
+               "Ring context image does not match ring context");
+
 class Genode::PPGTT_context
 {
 	private:
@@ -258,10 +361,10 @@ class Genode::PPGTT_context
 			struct Value : Bitfield<0,31> { };
 		};
 
-		static constexpr typename
-		Pdp_descriptor::access_t PDP_VALUE(unsigned int offset, Genode::uint32_t value)
+		static typename
+		Pdp_descriptor::access_t PDP_VALUE(addr_t ring_base, unsigned int offset, Genode::uint32_t value)
 		{
-			return Common_register::Mmio_offset::bits(RING_BASE + offset) |
+			return Common_register::Mmio_offset::bits(ring_base + offset) |
 			       Pdp_descriptor::Value::bits(value);
 		};
 
@@ -279,26 +382,86 @@ class Genode::PPGTT_context
 		Mi_noop					_noop_2[12];
 
 	public:
-		PPGTT_context (Genode::uint64_t pdp0_addr)
+
+		/*
+		 * Layout of the PPGTT context as plain data
+		 */
+		struct Image
+		{
+			Genode::uint64_t noop_1;
+			Genode::uint32_t load_register_immediate_header;
+			Genode::uint64_t ctx_timestamp;
+			Genode::uint64_t pdp[8];
+			Genode::uint64_t noop_2[12];
+		};
+
+		/*
+		 * PPGTT context without PDP0
+		 */
+		static constexpr Image golden(addr_t ring_base)
+		{
+			return Image {
+				0, 0x11001011,
+				golden_reg(ring_base, 0x3a8),
+				{
+					golden_reg(ring_base, 0x28c),
+					golden_reg(ring_base, 0x288),
+					golden_reg(ring_base, 0x284),
+					golden_reg(ring_base, 0x280),
+					golden_reg(ring_base, 0x27c),
+					golden_reg(ring_base, 0x278),
+					golden_reg(ring_base, 0x274),
+					golden_reg(ring_base, 0x270)
+				},
+				{ } };
+		}
+
+		/**
+		 * Constructor leaving the fields to a golden image
+		 */
+		PPGTT_context(From_golden_image) { }
+
+		PPGTT_context (addr_t ring_base, Genode::uint64_t pdp0_addr)
 		:
 			_load_register_immediate_header(0x11001011),
 
-			_ctx_timestamp(Common_register::Mmio_offset::bits(RING_BASE + 0x3a8) |
+			_ctx_timestamp(Common_register::Mmio_offset::bits(ring_base + 0x3a8) |
 				       Ctx_timestamp::Value::bits(0)),
 
-			_pdp3_udw(DEFAULT_OPAQUE_REG(RING_BASE, 0x28c)),
-			_pdp3_ldw(DEFAULT_OPAQUE_REG(RING_BASE, 0x288)),
-			_pdp2_udw(DEFAULT_OPAQUE_REG(RING_BASE, 0x284)),
-			_pdp2_ldw(DEFAULT_OPAQUE_REG(RING_BASE, 0x280)),
-			_pdp1_udw(DEFAULT_OPAQUE_REG(RING_BASE, 0x27c)),
-			_pdp1_ldw(DEFAULT_OPAQUE_REG(RING_BASE, 0x278)),
+			_pdp3_udw(DEFAULT_OPAQUE_REG(ring_base, 0x28c)),
+			_pdp3_ldw(DEFAULT_OPAQUE_REG(ring_base, 0x288)),
+			_pdp2_udw(DEFAULT_OPAQUE_REG(ring_base, 0x284)),
+			_pdp2_ldw(DEFAULT_OPAQUE_REG(ring_base, 0x280)),
+			_pdp1_udw(DEFAULT_OPAQUE_REG(ring_base, 0x27c)),
+			_pdp1_ldw(DEFAULT_OPAQUE_REG(ring_base, 0x278)),
 
-			_pdp0_udw(PDP_VALUE(0x274, (addr_t) (pdp0_addr >> 32))),
-			_pdp0_ldw(PDP_VALUE(0x270, (addr_t) (pdp0_addr & 0xffffffff)))
+			_pdp0_udw(PDP_VALUE(ring_base, 0x274, (addr_t) (pdp0_addr >> 32))),
+			_pdp0_ldw(PDP_VALUE(ring_base, 0x270, (addr_t) (pdp0_addr & 0xffffffff)))
 		{
 		};
+
+		/*
+		 * Context timestamp, written by the GPU when the context is saved
+		 */
+		Genode::uint32_t timestamp()
+		{
+			typename Ctx_timestamp::access_t const volatile *ts = &_ctx_timestamp;
+			return Ctx_timestamp::Value::get(*ts);
+		}
+
+		/*
+		 * Set PDP0 of a golden image
+		 */
+		void pdp0(Genode::uint64_t pdp0_addr)
+		{
+			Pdp_descriptor::Value::set(_pdp0_udw, (addr_t) (pdp0_addr >> 32));
+			Pdp_descriptor::Value::set(_pdp0_ldw, (addr_t) (pdp0_addr & 0xffffffff));
+		}
 };
 
+static_assert (sizeof (Genode::PPGTT_context::Image) == sizeof (Genode::PPGTT_context),
+               "PPGTT context image does not match PPGTT context");
+
 class Genode::Rcs_misc_context
 {
 	private:
@@ -309,6 +472,30 @@ class Genode::Rcs_misc_context
 		Mi_noop					_noop_2[12];
 
 	public:
+
+		enum { HAS_IMAGE = 1 };
+
+		/*
+		 * Layout of the misc context as plain data
+		 */
+		struct Image
+		{
+			Genode::uint64_t noop_1;
+			Genode::uint32_t load_register_immediate_header;
+			Genode::uint64_t r_pwr_clk_state;
+			Genode::uint64_t noop_2[12];
+		};
+
+		static constexpr Image golden()
+		{
+			return Image { 0, 0x11000001, golden_reg(0x2000, 0xc8), { } };
+		}
+
+		/**
+		 * Constructor leaving the fields to a golden image
+		 */
+		Rcs_misc_context(From_golden_image) { }
+
 		Rcs_misc_context()
 		:
 			_load_register_immediate_header(0x11000001),
@@ -317,7 +504,142 @@ class Genode::Rcs_misc_context
 		};
 };
 
+static_assert (sizeof (Genode::Rcs_misc_context::Image) == sizeof (Genode::Rcs_misc_context),
+               "Misc context image does not match misc context");
+
+/*
+ * Engines without misc LRI block
+ */
+struct Genode::No_misc_context
+{
+	enum { HAS_IMAGE = 0 };
+
+	No_misc_context() { }
+	No_misc_context(From_golden_image) { }
+};
+
+/*
+ * Golden image of all LRI blocks of an engine context
+ */
+template <typename MISC, bool>
+struct Genode::Lri_image
+{
+	Ring_context::Image      ring;
+	PPGTT_context::Image     ppgtt;
+	typename MISC::Image     misc;
+
+	static constexpr Lri_image golden(addr_t ring_base)
+	{
+		return Lri_image { Ring_context::golden(ring_base),
+		                   PPGTT_context::golden(ring_base),
+		                   MISC::golden() };
+	}
+};
+
+template <typename MISC>
+struct Genode::Lri_image<MISC, false>
+{
+	Ring_context::Image      ring;
+	PPGTT_context::Image     ppgtt;
+
+	static constexpr Lri_image golden(addr_t ring_base)
+	{
+		return Lri_image { Ring_context::golden(ring_base),
+		                   PPGTT_context::golden(ring_base) };
+	}
+};
+
+/*
+ * Part of the context common to all engines
+ *
+ * Software only accesses the status pages and the ring context, which are
+ * at the same place in the context of every engine.
+ */
+class Genode::Execlist_context
+{
+	public:
+
+		/* Offset of the LRI blocks within the context */
+		enum { STATE_OFFSET = (GUC_SHARED_PAGES + 2) * 4096 };
+
+	private:
+
+		Genode::uint8_t  _status_pages[STATE_OFFSET];
+		Ring_context     _ring_context;
+		PPGTT_context    _ppgtt_context;
+
+	public:
+
+		Execlist_context(addr_t ring_base,
+		                 addr_t ring_address,
+		                 size_t ring_length,
+		                 Genode::uint64_t pdp0_addr,
+		                 addr_t bb_per_ctx_addr,
+		                 addr_t ind_cs_ctx_addr,
+		                 size_t ind_cs_ctx_size,
+		                 size_t ind_cs_ctx_off)
+		:
+			_ring_context(ring_base, ring_address, ring_length,
+			              bb_per_ctx_addr, ind_cs_ctx_addr,
+			              ind_cs_ctx_size, ind_cs_ctx_off),
+			_ppgtt_context(ring_base, pdp0_addr)
+		{
+			memset(_status_pages, 0, sizeof(_status_pages));
+		}
+
+		/**
+		 * Constructor leaving the LRI blocks to a golden image
+		 */
+		Execlist_context(From_golden_image)
+		:
+			_ring_context(From_golden_image()),
+			_ppgtt_context(From_golden_image())
+		{
+			memset(_status_pages, 0, sizeof(_status_pages));
+		}
+
+		/*
+		 * Set per-context fields of LRI blocks copied from a golden image
+		 */
+		void patch(addr_t ring_address, size_t ring_length, Genode::uint64_t pdp0_addr)
+		{
+			_ring_context.ring(ring_address, ring_length);
+			_ppgtt_context.pdp0(pdp0_addr);
+		}
+
+		/*
+		 * The per-process hardware status page follows the GuC shared
+		 * pages
+		 */
+		enum { STATUS_PAGE_OFFSET = GUC_SHARED_PAGES * 4096 };
+
+		Genode::uint32_t volatile *status_page()
+		{
+			return (Genode::uint32_t volatile *)(_status_pages + STATUS_PAGE_OFFSET);
+		}
+
+		size_t head_offset()
+		{
+			return _ring_context.head_offset();
+		}
+
+		void tail_offset (addr_t offset)
+		{
+			_ring_context.tail_offset(offset);
+		}
+
+		Genode::uint32_t timestamp()
+		{
+			return _ppgtt_context.timestamp();
+		}
+};
+
 /*
+ * Size and engine-specific LRI blocks of the context of an engine
+ *
+ * STATE_PAGES is the number of pages following the status pages, which hold
+ * the execlist context, the misc LRI block and the engine context.
+ *
  * For the RCS context, from the documentation its not consistent how many
  * DWords are required for the engine context. In the docs (Volume 7: 3D Media
  * GPGPU) the second last element starts at DWord offset 3148 and is 8 DWords
@@ -336,58 +658,101 @@ class Genode::Rcs_misc_context
  * 	- other engines: 2 pages (8192 bytes)
  *
  * This makes 20 pages for all contexts in gen9 and 2 pages for HWSP,
- * i.e. 22 pages (TOTAL_PAGES).
+ * i.e. 22 pages. The copy, video and video enhancement engines only need a
+ * single page of register state and have no misc LRI block.
  */
+template <Genode::Engine ENGINE>
+struct Genode::Context_layout
+{
+	enum { STATE_PAGES = 1 };
+	typedef No_misc_context Misc_context;
+};
+
+template <>
+struct Genode::Context_layout<Genode::RCS>
+{
+	enum { STATE_PAGES = 20 };
+	typedef Rcs_misc_context Misc_context;
+};
 
-class Genode::Rcs_context
+/*
+ * Context of an engine
+ *
+ * The misc LRI block is a base class, so that it takes no space if the
+ * engine does not have one.
+ */
+template <Genode::Engine ENGINE>
+class Genode::Engine_context : public Execlist_context,
+                               public Context_layout<ENGINE>::Misc_context
 {
 	private:
-		enum { RCS_RING_BASE = 0x2000, TOTAL_PAGES = 22 };
-
-		static const size_t ENGINE_CONTEXT_SIZE =
-			(((TOTAL_PAGES - 2) * 4096) -
-			(sizeof (Ring_context<RCS_RING_BASE>) +
-			 sizeof (PPGTT_context<RCS_RING_BASE>) +
-			 sizeof (Rcs_misc_context)));
-
-		Genode::uint8_t			_status_pages[(GUC_SHARED_PAGES+2)*4096];
-		Ring_context<RCS_RING_BASE>	_ring_context;
-		PPGTT_context<RCS_RING_BASE>	_ppgtt_context;
-		Rcs_misc_context		_rcs_misc_context;
-		Genode::uint32_t		_engine_context[ENGINE_CONTEXT_SIZE/4];
+		typedef Context_layout<ENGINE>               Layout;
+		typedef typename Layout::Misc_context        Misc_context;
+
+		enum {
+			STATUS_SIZE = (GUC_SHARED_PAGES + 2) * 4096,
+			STATE_SIZE  = Layout::STATE_PAGES * 4096,
+			LRI_SIZE    = sizeof (Ring_context) +
+			              sizeof (PPGTT_context) +
+			              (Misc_context::HAS_IMAGE ? sizeof (Misc_context) : 0),
+		};
+
+		static_assert (LRI_SIZE < STATE_SIZE, "LRI blocks exceed engine context");
+		static_assert (LRI_SIZE % 4 == 0, "LRI blocks not DWord aligned");
+
+		static const size_t ENGINE_CONTEXT_SIZE = STATE_SIZE - LRI_SIZE;
+
+		Genode::uint32_t _engine_context[ENGINE_CONTEXT_SIZE/4];
+
+		typedef Lri_image<Misc_context> Golden;
+
+		// FIXME: We need to set R_PWR_CLK_STATE. See make_rpcs() in
+		// intel_lrc.c
+		static constexpr Golden _golden = Golden::golden(ring_base (ENGINE));
+
+		static_assert (sizeof (Golden) == LRI_SIZE, "Golden image does not match LRI blocks");
+
+		Genode::uint8_t *_lri() {
+			return (Genode::uint8_t *)static_cast<Execlist_context *>(this) + STATUS_SIZE; }
+
 	public:
-		Rcs_context(addr_t ring_address,
-			    size_t ring_length,
-			    Genode::uint64_t pdp0_addr,
-			    addr_t bb_per_ctx_addr = 0,
-			    addr_t ind_cs_ctx_addr = 0,
-			    size_t ind_cs_ctx_size = 0,
-			    size_t ind_cs_ctx_off  = 0)
+
+		/**
+		 * Size of the context in bytes
+		 */
+		enum { SIZE = STATUS_SIZE + STATE_SIZE };
+
+		Engine_context(addr_t ring_address,
+			       size_t ring_length,
+			       Genode::uint64_t pdp0_addr)
 		:
-			_ring_context(Ring_context<RCS_RING_BASE> (ring_address,
-								   ring_length,
-								   bb_per_ctx_addr,
-								   ind_cs_ctx_addr,
-								   ind_cs_ctx_size,
-								   ind_cs_ctx_off)),
-			_ppgtt_context (PPGTT_context<RCS_RING_BASE>(pdp0_addr)),
-			// FIXME: We need to set R_PWR_CLK_STATE. See make_rpcs() in
-			// intel_lrc.c
-			_rcs_misc_context (Rcs_misc_context())
+			Execlist_context(From_golden_image()),
+			Misc_context(From_golden_image())
 		{
-			memset(_status_pages, 0, sizeof(_status_pages));
+			static_assert (sizeof (Engine_context) == SIZE, "Unexpected context size");
+			static_assert (sizeof (Execlist_context) == STATUS_SIZE +
+			               sizeof (Ring_context) + sizeof (PPGTT_context),
+			               "Padding in execlist context");
+
+			reinit(ring_address, ring_length, pdp0_addr);
 			memset(_engine_context, 0, sizeof(_engine_context));
 		};
 
-		size_t head_offset()
-		{
-			return _ring_context.head_offset();
-		}
-
-		void tail_offset (addr_t offset)
+		/**
+		 * Write the LRI blocks for a new ring and PPGTT
+		 *
+		 * Used contexts are prepared by this as well. The golden image
+		 * sets Engine_context_restore_inhibit again, so the engine does not
+		 * load the state saved by the previous user of the context.
+		 */
+		void reinit(addr_t ring_address, size_t ring_length, Genode::uint64_t pdp0_addr)
 		{
-			_ring_context.tail_offset(offset);
+			memcpy(_lri(), &_golden, sizeof(_golden));
+			patch(ring_address, ring_length, pdp0_addr);
 		}
 };
 
+template <Genode::Engine ENGINE>
+constexpr typename Genode::Engine_context<ENGINE>::Golden Genode::Engine_context<ENGINE>::_golden;
+
 #endif /* _CONTEXT_H_ */
@@ -0,0 +1,174 @@
+/*
+ * \brief  Pool of recycled GPU contexts
+ * \author Alexander Senier
+ * \date   2017-01-26
+ */
+
+/*
+ * Creating a context allocates the context image, which is 23 pages for the
+ * RCS, its ring buffer and its PPGTT, and clears all of them. The pool keeps
+ * these objects when a submission is torn down and hands them to the next
+ * submission of the same engine and ring size.
+ *
+ * A recycled image is not cleared. Only its LRI blocks are copied from the
+ * golden image of the engine again, which also sets
+ * Engine_context_restore_inhibit, so the engine never loads the stale engine
+ * state. The PPGTT is released with
+ * only the status page mapped. That mapping remains valid, as image and
+ * PPGTT are always recycled together.
+ */
+
+#ifndef _CONTEXT_POOL_H_
+#define _CONTEXT_POOL_H_
+
+#include <util/list.h>
+#include <spec/x86_64/translation_table.h>
+#include <translation_table_allocator.h>
+#include <context.h>
+#include <engine.h>
+
+namespace Genode {
+
+	class Context_pool;
+}
+
+class Genode::Context_pool
+{
+	public:
+
+		/*
+		 * Context image, ring buffer and PPGTT of a submission
+		 */
+		struct Context
+		{
+			Execlist_context  *image;
+			Translation_table *ppgtt;
+			void              *ring;
+			size_t             ring_len;
+
+			/* Image and PPGTT were used before */
+			bool               recycled;
+		};
+
+	private:
+
+		struct Entry : List<Entry>::Element
+		{
+			Engine  const engine;
+			Context const context;
+
+			Entry(Engine engine, Context const &context)
+			: engine (engine), context (context) { }
+		};
+
+		Translation_table_allocator &_alloc;
+		Allocator                   &_md_alloc;
+		List<Entry>                  _free;
+
+		unsigned long _created  = 0;
+		unsigned long _recycled = 0;
+
+		addr_t _phys(void *addr) { return (addr_t)_alloc.phys_addr (addr); }
+
+		template <Engine ENGINE>
+		Execlist_context *_create(addr_t ring, size_t ring_len, addr_t ppgtt)
+		{
+			return new (&_alloc) Engine_context<ENGINE> (ring, ring_len, ppgtt);
+		}
+
+		template <Engine ENGINE>
+		void _reinit(Execlist_context *image, addr_t ring, size_t ring_len, addr_t ppgtt)
+		{
+			static_cast<Engine_context<ENGINE> *>(image)->reinit (ring, ring_len, ppgtt);
+		}
+
+		void _reinit_image(Engine engine, Execlist_context *image, addr_t ring,
+		                   size_t ring_len, addr_t ppgtt)
+		{
+			switch (engine) {
+			case RCS:  _reinit<RCS> (image, ring, ring_len, ppgtt); break;
+			case BCS:  _reinit<BCS> (image, ring, ring_len, ppgtt); break;
+			case VCS0: _reinit<VCS0>(image, ring, ring_len, ppgtt); break;
+			case VCS1: _reinit<VCS1>(image, ring, ring_len, ppgtt); break;
+			case VECS: _reinit<VECS>(image, ring, ring_len, ppgtt); break;
+			default:   break;
+			}
+		}
+
+		/*
+		 * Engine contexts differ in size, but are only accessed through
+		 * their common execlist part
+		 */
+		Execlist_context *_create_image(Engine engine, addr_t ring,
+		                                size_t ring_len, addr_t ppgtt)
+		{
+			switch (engine) {
+			case RCS:  return _create<RCS> (ring, ring_len, ppgtt);
+			case BCS:  return _create<BCS> (ring, ring_len, ppgtt);
+			case VCS0: return _create<VCS0>(ring, ring_len, ppgtt);
+			case VCS1: return _create<VCS1>(ring, ring_len, ppgtt);
+			case VECS: return _create<VECS>(ring, ring_len, ppgtt);
+			default:   break;
+			}
+			return nullptr;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param alloc     allocator of DMA memory for contexts
+		 * \param md_alloc  allocator for pool metadata
+		 */
+		Context_pool(Translation_table_allocator &alloc, Allocator &md_alloc)
+		: _alloc (alloc), _md_alloc (md_alloc) { }
+
+		/**
+		 * Get context of 'engine' with a ring of 'ring_len' bytes
+		 */
+		Context acquire(Engine engine, size_t ring_len)
+		{
+			for (Entry *e = _free.first(); e; e = e->next()) {
+
+				if (e->engine != engine || e->context.ring_len != ring_len)
+					continue;
+
+				Context c = e->context;
+				_free.remove (e);
+				destroy (&_md_alloc, e);
+
+				_reinit_image (engine, c.image, _phys (c.ring), ring_len, _phys (c.ppgtt));
+				c.recycled = true;
+
+				_recycled++;
+				return c;
+			}
+
+			Context c;
+			c.ppgtt    = new (&_alloc) Translation_table();
+			c.ring     = _alloc.alloc (ring_len);
+			c.ring_len = ring_len;
+			c.image    = _create_image (engine, _phys (c.ring), ring_len, _phys (c.ppgtt));
+			c.recycled = false;
+
+			_created++;
+			return c;
+		}
+
+		/**
+		 * Return context for reuse
+		 *
+		 * The GPU must have switched out the context and its PPGTT must not
+		 * map anything but the status page.
+		 */
+		void release(Engine engine, Context const &context)
+		{
+			_free.insert (new (&_md_alloc) Entry (engine, context));
+		}
+
+		unsigned long created()  const { return _created; }
+		unsigned long recycled() const { return _recycled; }
+};
+
+#endif /* _CONTEXT_POOL_H_ */
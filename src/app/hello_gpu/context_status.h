@@ -0,0 +1,151 @@
+/*
+ * \brief  Context status buffer
+ * \author Alexander Senier
+ * \date   2017-01-13
+ */
+
+/*
+ * Whenever a context switches state, the engine writes a context status
+ * entry into a 6-entry circular buffer. The buffer and its write pointer are
+ * mirrored into the hardware status page (HWSP), so events can be polled
+ * from memory without reading MMIO registers. Software acknowledges consumed
+ * entries by writing its read pointer to RING_CONTEXT_STATUS_PTR.
+ *
+ * See PRM Volume 2c: Command Reference: Registers, CTXT_ST_BUF and
+ * Volume 7: 3D-Media-GPGPU, section "Context Status".
+ */
+
+#ifndef _CONTEXT_STATUS_H_
+#define _CONTEXT_STATUS_H_
+
+#include <util/register.h>
+
+namespace Genode {
+
+	class Context_status_buffer;
+}
+
+class Genode::Context_status_buffer
+{
+	public:
+
+		enum {
+			ENTRIES = 6,
+
+			/* DWord indices into the hardware status page */
+			HWSP_CSB_BUF0_INDEX  = 0x10,
+			HWSP_CSB_WRITE_INDEX = 0x1f,
+
+			/* Write pointer value after reset, no entry written yet */
+			RESET_POINTER = 0x7
+		};
+
+		struct Status : Register<32>
+		{
+			struct Idle_to_active    : Bitfield< 0, 1> { };
+			struct Preempted         : Bitfield< 1, 1> { };
+			struct Element_switch    : Bitfield< 2, 1> { };
+			struct Active_to_idle    : Bitfield< 3, 1> { };
+			struct Context_complete  : Bitfield< 4, 1> { };
+			struct Wait_on_sync      : Bitfield< 5, 1> { };
+			struct Wait_on_vblank    : Bitfield< 6, 1> { };
+			struct Wait_on_semaphore : Bitfield< 7, 1> { };
+			struct Wait_on_scanline  : Bitfield< 8, 1> { };
+			struct Lite_restore      : Bitfield<15, 1> { };
+		};
+
+		struct Context_id : Register<32>
+		{
+			struct Id : Bitfield< 0, 20> { };
+		};
+
+		class Event
+		{
+			private:
+
+				typename Status::access_t     _status;
+				typename Context_id::access_t _context_id;
+
+			public:
+
+				Event(uint32_t status, uint32_t context_id)
+				: _status (status), _context_id (context_id) { }
+
+				unsigned int context_id() const { return Context_id::Id::get(_context_id); }
+				uint32_t     status()     const { return _status; }
+
+				bool idle_to_active() const { return Status::Idle_to_active::get(_status); }
+				bool preempted()      const { return Status::Preempted::get(_status); }
+				bool element_switch() const { return Status::Element_switch::get(_status); }
+				bool active_to_idle() const { return Status::Active_to_idle::get(_status); }
+				bool complete()       const { return Status::Context_complete::get(_status); }
+				bool lite_restore()   const { return Status::Lite_restore::get(_status); }
+		};
+
+	private:
+
+		uint32_t const volatile *_hwsp;
+
+		/* Index of the last entry consumed */
+		unsigned int _read = ENTRIES - 1;
+
+		unsigned int _write_pointer() const
+		{
+			return _hwsp[HWSP_CSB_WRITE_INDEX] & 0x7;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * Must be called before the first context is submitted to the
+		 * engine. The engine does not reset the write pointer in the
+		 * status page, which is therefore set to its reset value here.
+		 */
+		Context_status_buffer(void *hwsp) : _hwsp ((uint32_t const volatile *)hwsp)
+		{
+			((uint32_t volatile *)hwsp)[HWSP_CSB_WRITE_INDEX] = RESET_POINTER;
+		}
+
+		/**
+		 * True if the engine wrote entries not consumed yet
+		 */
+		bool pending() const
+		{
+			unsigned int const write = _write_pointer();
+			return write != RESET_POINTER && write != _read;
+		}
+
+		/**
+		 * Read pointer to be reported to the engine
+		 */
+		unsigned int read_pointer() const { return _read; }
+
+		/**
+		 * Call 'fn' for every new entry in the order written by the engine
+		 *
+		 * \return  number of entries processed
+		 */
+		template <typename FUNC>
+		unsigned int process(FUNC const &fn)
+		{
+			unsigned int const write = _write_pointer();
+			unsigned int count = 0;
+
+			if (write == RESET_POINTER || write >= ENTRIES)
+				return 0;
+
+			while (_read != write) {
+				_read = (_read + 1) % ENTRIES;
+
+				uint32_t const volatile *entry = _hwsp + HWSP_CSB_BUF0_INDEX + 2 * _read;
+				fn (Event (entry[0], entry[1]));
+				count++;
+			}
+
+			return count;
+		}
+};
+
+#endif /* _CONTEXT_STATUS_H_ */
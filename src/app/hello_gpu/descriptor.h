@@ -62,10 +62,10 @@ class Genode::Context_descriptor
 			 bool		force_restore    = false,
 			 bool		force_pd_restore = false)
 		:
-			_value(Format::Context_id::Group::bits(group) |
-			       Format::Context_id::Mbz::bits(0) |
-			       Format::Context_id::Id::bits(id)|
-			       Format::Logical_ring_context_address::bits(lrca_addr) |
+			_value(Format::Context_id::bits(Format::Context_id::Group::bits(group) |
+			                                Format::Context_id::Mbz::bits(0) |
+			                                Format::Context_id::Id::bits(id)) |
+			       Format::Logical_ring_context_address::bits(lrca_addr >> 12) |
 			       Format::Reserved_mbz_1::bits(0) |
 			       Format::Privilege_access::bits(1) |
 			       Format::Fault_handling::bits(Format::Fault_handling::FAULT_AND_HANG) |
@@ -96,6 +96,19 @@ class Genode::Context_descriptor
 		{
 			return Format::Valid::get(_value) == 1;
 		}
+
+		unsigned int id() const
+		{
+			return Format::Context_id::Id::get(Format::Context_id::get(_value));
+		}
+
+		/*
+		 * Graphics address of the context image
+		 */
+		Genode::addr_t lrca() const
+		{
+			return Format::Logical_ring_context_address::masked(_value);
+		}
 };
 
 #endif //_CONTEXT_DESCRIPTOR_H_
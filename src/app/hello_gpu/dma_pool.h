@@ -0,0 +1,167 @@
+/*
+ * \brief  Pool sub-allocator for DMA memory
+ * \author Alexander Senier
+ * \date   2017-01-19
+ */
+
+/*
+ * Allocating every object as a separate DMA buffer costs an RPC to the
+ * platform driver, a region-map attach and an address map entry. The pool
+ * instead carves large chunks of DMA memory into pages and power-of-two
+ * size classes from 64 bytes up to a page. Each class has its own free list,
+ * so allocation and free are O(1). Objects are naturally aligned to their
+ * size class, so page-sized objects (e.g. translation tables) are page
+ * aligned.
+ *
+ * Free lists are linked through the free objects themselves. Pages assigned
+ * to a size class are not returned to the page list.
+ */
+
+#ifndef _DMA_POOL_H_
+#define _DMA_POOL_H_
+
+#include <base/allocator.h>
+#include <address_index.h>
+
+namespace Genode {
+
+	class Dma_pool;
+}
+
+class Genode::Dma_pool
+{
+	public:
+
+		enum {
+			CHUNK_SIZE_LOG2 = 21,
+			CHUNK_SIZE      = 1UL << CHUNK_SIZE_LOG2,
+			PAGE_SIZE_LOG2  = 12,
+			PAGE_SIZE       = 1UL << PAGE_SIZE_LOG2,
+			MIN_CLASS_LOG2  = 6,
+			NUM_CLASSES     = PAGE_SIZE_LOG2 - MIN_CLASS_LOG2 + 1,
+			PAGE_CLASS      = NUM_CLASSES - 1,
+		};
+
+	private:
+
+		enum { PAGES_PER_CHUNK = CHUNK_SIZE / PAGE_SIZE };
+
+		struct Free { Free *next; };
+
+		struct Chunk
+		{
+			addr_t  base;
+			uint8_t page_class[PAGES_PER_CHUNK];
+		};
+
+		Allocator            &_md_alloc;
+		Address_index<Chunk>  _chunks;
+		Free                 *_free[NUM_CLASSES];
+
+		static unsigned _class(size_t size)
+		{
+			unsigned c = 0;
+			while ((1UL << (c + MIN_CLASS_LOG2)) < size)
+				c++;
+			return c;
+		}
+
+		void _push(unsigned c, void *addr)
+		{
+			Free *f = (Free *)addr;
+			f->next = _free[c];
+			_free[c] = f;
+		}
+
+		void *_pop(unsigned c)
+		{
+			Free *f = _free[c];
+			if (f)
+				_free[c] = f->next;
+			return f;
+		}
+
+		Chunk *_chunk(void *addr) const { return _chunks.lookup((addr_t)addr); }
+
+		static size_t _page(Chunk const *chunk, void *addr)
+		{
+			return ((addr_t)addr - chunk->base) >> PAGE_SIZE_LOG2;
+		}
+
+	public:
+
+		Dma_pool(Allocator &md_alloc)
+		:
+			_md_alloc(md_alloc), _chunks(md_alloc, CHUNK_SIZE_LOG2)
+		{
+			for (unsigned c = 0; c < NUM_CLASSES; c++)
+				_free[c] = nullptr;
+		}
+
+		/**
+		 * True if objects of 'size' bytes are served by the pool
+		 */
+		static bool fits(size_t size) { return size && size <= PAGE_SIZE; }
+
+		/**
+		 * Add a chunk of CHUNK_SIZE bytes of DMA memory to the pool
+		 */
+		void add_chunk(void *base)
+		{
+			Chunk *chunk = new (&_md_alloc) Chunk;
+			chunk->base = (addr_t)base;
+			_chunks.insert(chunk->base, CHUNK_SIZE, chunk);
+
+			for (size_t i = PAGES_PER_CHUNK; i > 0; i--) {
+				chunk->page_class[i - 1] = PAGE_CLASS;
+				_push(PAGE_CLASS, (void *)(chunk->base + ((i - 1) << PAGE_SIZE_LOG2)));
+			}
+		}
+
+		/**
+		 * Allocate object
+		 *
+		 * \return  nullptr if the pool needs another chunk
+		 */
+		void *alloc(size_t size)
+		{
+			unsigned const c = _class(size);
+
+			if (void *obj = _pop(c))
+				return obj;
+
+			if (c == PAGE_CLASS)
+				return nullptr;
+
+			/* Split a page into objects of the size class */
+			void *page = _pop(PAGE_CLASS);
+			if (!page)
+				return nullptr;
+
+			Chunk *chunk = _chunk(page);
+			chunk->page_class[_page(chunk, page)] = c;
+
+			size_t const obj_size = 1UL << (c + MIN_CLASS_LOG2);
+			for (size_t off = PAGE_SIZE - obj_size; off > 0; off -= obj_size)
+				_push(c, (void *)((addr_t)page + off));
+
+			return page;
+		}
+
+		/**
+		 * Free object
+		 *
+		 * \return  false if the object was not allocated from the pool
+		 */
+		bool free(void *addr)
+		{
+			Chunk *chunk = _chunk(addr);
+			if (!chunk)
+				return false;
+
+			_push(chunk->page_class[_page(chunk, addr)], addr);
+			return true;
+		}
+};
+
+#endif /* _DMA_POOL_H_ */
@@ -0,0 +1,63 @@
+/*
+ * \brief  GPU engines
+ * \author Alexander Senier
+ * \date   2017-01-23
+ */
+
+/*
+ * Every engine has its own command streamer with a separate set of ring
+ * registers, execlist submit port, context status buffer and global hardware
+ * status page. The register layout relative to the engine's ring base is the
+ * same for all engines.
+ *
+ * Engine interrupts are reported in the GT interrupt registers, 16 bits per
+ * engine: RCS and BCS in GT_0, VCS0 and VCS1 in GT_1, VECS in GT_3.
+ */
+
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <base/stdint.h>
+
+namespace Genode {
+
+	enum Engine { RCS, BCS, VCS0, VCS1, VECS, NUM_ENGINES };
+
+	/**
+	 * MMIO base of the ring registers of an engine
+	 */
+	constexpr addr_t ring_base(Engine e)
+	{
+		return e == RCS  ? 0x02000 :
+		       e == BCS  ? 0x22000 :
+		       e == VCS0 ? 0x12000 :
+		       e == VCS1 ? 0x1c000 :
+		                   0x1a000;
+	}
+
+	/**
+	 * Index of the GT interrupt register bank of an engine
+	 */
+	constexpr unsigned gt_interrupt_bank(Engine e)
+	{
+		return e == RCS || e == BCS   ? 0 :
+		       e == VCS0 || e == VCS1 ? 1 :
+		                                3;
+	}
+
+	/**
+	 * Position of the engine's bits within its GT interrupt register
+	 */
+	constexpr unsigned gt_interrupt_shift(Engine e)
+	{
+		return e == BCS || e == VCS1 ? 16 : 0;
+	}
+
+	inline char const *engine_name(Engine e)
+	{
+		static char const *names[NUM_ENGINES] = { "RCS", "BCS", "VCS0", "VCS1", "VECS" };
+		return names[e];
+	}
+}
+
+#endif /* _ENGINE_H_ */
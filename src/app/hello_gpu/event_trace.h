@@ -0,0 +1,208 @@
+/*
+ * \brief  Trace of submission, completion and fault events
+ * \author Alexander Senier
+ * \date   2017-02-01
+ */
+
+/*
+ * Events are recorded into a fixed ring of binary records, overwriting the
+ * oldest ones. A trace point claims its slot by an atomic increment of the
+ * write index, so trace points need no lock and may be hit concurrently.
+ * The cost of an enabled trace point is the increment, reading the
+ * timestamp counter and a 24 byte store. A disabled trace point only tests
+ * a flag.
+ *
+ * The trace is exported as XML, e.g., for a report, or in the Chrome trace
+ * event format, which can be loaded into chrome://tracing. Events recorded
+ * during an export may show up torn, so the trace should be exported while
+ * the GPU is idle.
+ */
+
+#ifndef _EVENT_TRACE_H_
+#define _EVENT_TRACE_H_
+
+#include <base/snprintf.h>
+#include <base/trace/timestamp.h>
+#include <util/xml_generator.h>
+
+#include <engine.h>
+
+namespace Genode {
+
+	class Event_trace;
+
+	inline Event_trace &event_trace();
+}
+
+class Genode::Event_trace
+{
+	public:
+
+		enum Type {
+			RING_INSERT, /* arg: sequence number of the job */
+			ELSP_WRITE,  /* arg: context ID of element 1 */
+			CSB_EVENT,   /* arg: context status */
+			SEQNO,       /* arg: sequence number completed */
+			FAULT,       /* arg: error register or faulting address */
+			ALLOC,       /* arg: size of DMA buffer */
+			NUM_TYPES
+		};
+
+		/* Engine of events not related to an engine */
+		enum { NO_ENGINE = NUM_ENGINES };
+
+		enum { CAPACITY_LOG2 = 12, CAPACITY = 1 << CAPACITY_LOG2 };
+
+		struct Event
+		{
+			Trace::Timestamp timestamp;
+			Genode::uint16_t type;
+			Genode::uint16_t engine;
+			Genode::uint32_t context;
+			Genode::uint64_t arg;
+		};
+
+		static char const *type_name(unsigned type)
+		{
+			static char const *names[NUM_TYPES] = {
+				"ring_insert", "elsp_write", "csb_event", "seqno", "fault", "alloc" };
+			return type < NUM_TYPES ? names[type] : "unknown";
+		}
+
+	private:
+
+		Event          _events[CAPACITY];
+		unsigned long  _written = 0;
+		bool           _enabled = false;
+
+		static char const *_engine_name(unsigned engine) {
+			return engine < NUM_ENGINES ? engine_name ((Engine)engine) : "none"; }
+
+		/*
+		 * Call 'fn' for all events from the oldest to the newest
+		 */
+		template <typename FUNC>
+		void _for_each(FUNC const &fn) const
+		{
+			unsigned long const written = __atomic_load_n (&_written, __ATOMIC_ACQUIRE);
+			unsigned long const first   = written > CAPACITY ? written - CAPACITY : 0;
+
+			for (unsigned long i = first; i < written; i++)
+				fn (_events[i & (CAPACITY - 1)]);
+		}
+
+	public:
+
+		void enabled(bool enabled) { _enabled = enabled; }
+		bool enabled() const { return _enabled; }
+
+		/**
+		 * Record event
+		 *
+		 * \param engine  engine or NO_ENGINE
+		 */
+		void record(Type type, unsigned engine, unsigned context, Genode::uint64_t arg)
+		{
+			if (!_enabled)
+				return;
+
+			unsigned long const i = __atomic_fetch_add (&_written, 1, __ATOMIC_RELAXED);
+
+			Event &e  = _events[i & (CAPACITY - 1)];
+			e.timestamp = Trace::timestamp();
+			e.type      = type;
+			e.engine    = engine;
+			e.context   = context;
+			e.arg       = arg;
+		}
+
+		/**
+		 * Number of events recorded since construction, including the ones
+		 * already overwritten
+		 */
+		unsigned long written() const { return _written; }
+
+		/**
+		 * Number of recorded events of 'type' still in the trace
+		 */
+		unsigned long count(Type type) const
+		{
+			unsigned long count = 0;
+			_for_each ([&] (Event const &e) { count += e.type == type; });
+			return count;
+		}
+
+		/**
+		 * Generate '<event>' nodes of all events
+		 */
+		void xml(Xml_generator &xml) const
+		{
+			_for_each ([&] (Event const &e) {
+				xml.node ("event", [&] () {
+					xml.attribute ("type",      type_name (e.type));
+					xml.attribute ("engine",    _engine_name (e.engine));
+					xml.attribute ("context",   (unsigned long)e.context);
+					xml.attribute ("timestamp", (unsigned long)e.timestamp);
+					xml.attribute ("arg",       (unsigned long)e.arg);
+				});
+			});
+		}
+
+		/**
+		 * Write trace in the Chrome trace event format
+		 *
+		 * Events are emitted as instant events, one thread per engine.
+		 * Events that do not fit into 'dst' are dropped.
+		 *
+		 * \param ticks_per_us  timestamp counter rate
+		 *
+		 * \return  length of the null-terminated JSON text
+		 */
+		size_t chrome_json(char *dst, size_t size, Trace::Timestamp ticks_per_us) const
+		{
+			enum { MAX_EVENT_LEN = 160 };
+
+			if (size < 32)
+				return 0;
+
+			size_t len = snprintf (dst, size, "{\"traceEvents\":[");
+			bool   first = true;
+
+			if (!ticks_per_us)
+				ticks_per_us = 1;
+
+			_for_each ([&] (Event const &e) {
+
+				if (len + MAX_EVENT_LEN + 4 > size)
+					return;
+
+				/* Time stamps are in microseconds with nanosecond fraction */
+				Trace::Timestamp const us = e.timestamp / ticks_per_us;
+				unsigned         const ns = (e.timestamp - us * ticks_per_us) * 1000 / ticks_per_us;
+
+				len += snprintf (dst + len, size - len,
+				                 "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+				                 "\"ts\":%llu.%u%u%u,\"pid\":0,\"tid\":\"%s\","
+				                 "\"args\":{\"context\":%u,\"arg\":%llu}}",
+				                 first ? "" : ",", type_name (e.type),
+				                 (unsigned long long)us, ns / 100, ns / 10 % 10, ns % 10,
+				                 _engine_name (e.engine), (unsigned)e.context,
+				                 (unsigned long long)e.arg);
+				first = false;
+			});
+
+			len += snprintf (dst + len, size - len, "]}");
+			return len;
+		}
+};
+
+/**
+ * Trace shared by all parts of the driver
+ */
+Genode::Event_trace &Genode::event_trace()
+{
+	static Event_trace trace;
+	return trace;
+}
+
+#endif /* _EVENT_TRACE_H_ */
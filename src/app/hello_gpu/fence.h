@@ -0,0 +1,77 @@
+/*
+ * \brief  Sequence number fences
+ * \author Alexander Senier
+ * \date   2017-01-17
+ */
+
+/*
+ * After every batch buffer, the ring writes the batch's sequence number into
+ * the hardware status page by the post-sync write of a flush, i.e., after
+ * the writes of the batch reached memory. As batches of a context complete
+ * in order, a batch is done once the stored value reached its sequence
+ * number. Checking a fence therefore is a single memory load.
+ */
+
+#ifndef _FENCE_H_
+#define _FENCE_H_
+
+#include <base/stdint.h>
+#include <base/trace/timestamp.h>
+
+namespace Genode {
+
+	class Fence;
+}
+
+class Genode::Fence
+{
+	public:
+
+		/* DWord index of the sequence number in the hardware status page */
+		enum { HWSP_SEQNO_INDEX = 0x30 };
+
+	private:
+
+		uint32_t const volatile *_seqno;
+
+	public:
+
+		Fence(uint32_t volatile *hwsp) : _seqno (hwsp + HWSP_SEQNO_INDEX) { }
+
+		/**
+		 * Sequence number of the last completed batch
+		 */
+		uint32_t completed() const { return *_seqno; }
+
+		/**
+		 * True if the batch with sequence number 'seqno' completed
+		 *
+		 * The comparison is safe across wraparound of the sequence number.
+		 */
+		bool signaled(uint32_t const seqno) const
+		{
+			return (int32_t)(*_seqno - seqno) >= 0;
+		}
+
+		/**
+		 * Spin until the batch with sequence number 'seqno' completed
+		 *
+		 * \param cycles  timestamp counter ticks to spin at most, e.g.,
+		 *                if the GPU hangs
+		 *
+		 * \return  false if the batch did not complete in time
+		 */
+		bool wait(uint32_t const seqno, Trace::Timestamp const cycles) const
+		{
+			Trace::Timestamp const start = Trace::timestamp();
+
+			while (!signaled(seqno)) {
+				if (Trace::timestamp() - start > cycles)
+					return false;
+				asm volatile ("pause");
+			}
+			return true;
+		}
+};
+
+#endif /* _FENCE_H_ */
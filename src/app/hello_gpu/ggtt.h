@@ -0,0 +1,166 @@
+/*
+ * \brief  Global graphics translation table
+ * \author Alexander Senier
+ * \date   2017-01-20
+ */
+
+/*
+ * The GGTT is a flat array of 64 bit entries in the upper half of BAR0, one
+ * per 4 KiB page of the global graphics address space. Ranges of the address
+ * space are handed out by an AVL allocator, so buffers can be bound without
+ * the caller choosing indices.
+ *
+ * Entries are written as uncached MMIO stores. Making them visible to the
+ * GPU requires a posting read and a GGTT TLB invalidate, which are expensive
+ * compared to the stores themselves. All runs written within a 'batch' are
+ * therefore flushed together with a single invalidate and posting read.
+ *
+ * The first page is never handed out, so address 0 stays invalid.
+ */
+
+#ifndef _GGTT_H_
+#define _GGTT_H_
+
+#include <base/allocator_avl.h>
+#include <util/register.h>
+#include <util/misc_math.h>
+#include <igd.h>
+
+namespace Genode {
+
+	class Ggtt;
+}
+
+class Genode::Ggtt
+{
+	public:
+
+		enum { PAGE_SIZE_LOG2 = 12, PAGE_SIZE = 1UL << PAGE_SIZE_LOG2 };
+
+		struct Pte : Register<64>
+		{
+			struct Present : Bitfield< 0,  1> { };
+			struct Address : Bitfield<12, 27> { };
+
+			static access_t create(addr_t pa)
+			{
+				return Present::bits(1) | Address::masked(pa);
+			}
+		};
+
+	private:
+
+		IGD           &_igd;
+		Allocator_avl  _range;
+		size_t const   _size;
+
+		unsigned _batch = 0;
+		bool     _dirty = false;
+
+		void _flush()
+		{
+			if (_batch || !_dirty)
+				return;
+
+			_igd.flush_gtt();
+			_dirty = false;
+		}
+
+		void _write(addr_t ga, addr_t pa, size_t size, bool present)
+		{
+			assert (!((ga | pa | size) & (PAGE_SIZE - 1)));
+			assert (ga + size <= _size);
+
+			unsigned long const first = ga >> PAGE_SIZE_LOG2;
+			unsigned long const count = size >> PAGE_SIZE_LOG2;
+
+			for (unsigned long i = 0; i < count; i++)
+				_igd.write_gtt (first + i, present ? Pte::create (pa + (i << PAGE_SIZE_LOG2)) : 0);
+
+			_dirty = true;
+			_flush();
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param size  size of the global graphics address space
+		 */
+		Ggtt(IGD &igd, Allocator &md_alloc, size_t size)
+		:
+			_igd (igd), _range (&md_alloc), _size (size)
+		{
+			_range.add_range (PAGE_SIZE, size - PAGE_SIZE);
+		}
+
+		/**
+		 * Allocate range of the global graphics address space
+		 *
+		 * \return  false if no range of 'size' bytes is available
+		 */
+		bool alloc(size_t size, addr_t &ga, unsigned align_log2 = PAGE_SIZE_LOG2)
+		{
+			void *addr = nullptr;
+			size = align_addr (size, PAGE_SIZE_LOG2);
+
+			if (_range.alloc_aligned (size, &addr, align_log2).error())
+				return false;
+
+			ga = (addr_t)addr;
+			return true;
+		}
+
+		/**
+		 * Map physically contiguous memory to an allocated range
+		 *
+		 * Rebinding a range to other memory is the same operation.
+		 */
+		void insert(addr_t ga, addr_t pa, size_t size) { _write (ga, pa, size, true); }
+
+		/**
+		 * Invalidate entries of a range
+		 */
+		void clear(addr_t ga, size_t size) { _write (ga, 0, size, false); }
+
+		/**
+		 * Allocate range and map physically contiguous memory to it
+		 *
+		 * \return  false if no range of 'size' bytes is available
+		 */
+		bool bind(addr_t pa, size_t size, addr_t &ga)
+		{
+			if (!alloc (size, ga))
+				return false;
+
+			insert (ga, pa, align_addr (size, PAGE_SIZE_LOG2));
+			return true;
+		}
+
+		/**
+		 * Invalidate entries of a range and release it
+		 */
+		void unbind(addr_t ga, size_t size)
+		{
+			clear (ga, align_addr (size, PAGE_SIZE_LOG2));
+			_range.free ((void *)ga);
+		}
+
+		/**
+		 * Call 'fn' and flush all entries written by it at once
+		 *
+		 * Batches may be nested, only the outermost one flushes.
+		 */
+		template <typename FUNC>
+		void batch(FUNC const &fn)
+		{
+			_batch++;
+			fn();
+			_batch--;
+
+			_flush();
+		}
+};
+
+#endif /* _GGTT_H_ */
@@ -8,131 +8,214 @@
 #define _GPU_ALLOCATOR_H_
 
 #include <platform_session/connection.h>
+#include <dataspace/client.h>
+#include <base/heap.h>
+#include <base/tslab.h>
+#include <util/misc_math.h>
+#include <util/retry.h>
+#include <address_index.h>
+#include <dma_pool.h>
+#include <quota.h>
 #include <translation_table_allocator.h>
+#include <event_trace.h>
 
 namespace Genode {
 
 	class Address_map_element;
-	template <unsigned int ELEMENTS> class Address_map;
-	template <unsigned int ELEMENTS> class GPU_allocator;
+	class Address_map;
+	class GPU_allocator;
 }
 
 struct Genode::Address_map_element
 {
 	public:
-		bool                      valid;
 		Ram_dataspace_capability  ds_cap;
 		void                     *virt;
 		void                     *phys;
-		unsigned int              index;
+		size_t                    size;
 
-		Address_map_element() : valid(false) {}
-
-		Address_map_element(int index, Ram_dataspace_capability ds_cap, void *virt)
+		Address_map_element(Ram_dataspace_capability ds_cap, void *virt)
 		:
-			valid(true),
 			ds_cap(ds_cap),
 			virt(virt),
 			phys((void *)Genode::Dataspace_client (ds_cap).phys_addr()),
-			index(index)
+			size(Genode::Dataspace_client (ds_cap).size())
 		{ }
 };
 
-template <unsigned int ELEMENTS>
+/*
+ * Map of DMA buffers by virtual and physical address
+ *
+ * Elements are allocated from a slab, so the map grows on demand. Buffers
+ * smaller than 2 MiB are indexed per 4 KiB page, larger buffers per 2 MiB
+ * region. This keeps the number of index nodes per buffer bounded while
+ * every lookup hashes exactly one page and at most one region.
+ */
 class Genode::Address_map
 {
-	Address_map_element _map[ELEMENTS];
+	private:
 
-	public:
+		enum { PAGE_SIZE_LOG2 = 12, REGION_SIZE_LOG2 = 21 };
+
+		Tslab<Address_map_element, 4096> _elements;
+
+		typedef Address_index<Address_map_element> Index;
+
+		Index _virt_pages;
+		Index _virt_regions;
+		Index _phys_pages;
+		Index _phys_regions;
 
-		Address_map()
+		bool _large(Address_map_element const *e) const
 		{
-			memset(&_map, 0, sizeof(_map));
+			return e->size >= (1UL << REGION_SIZE_LOG2);
 		}
 
+		static Address_map_element *_lookup(Index const &regions,
+		                                    Index const &pages,
+		                                    void *addr)
+		{
+			Address_map_element *e = regions.lookup((addr_t)addr);
+			return e ? e : pages.lookup((addr_t)addr);
+		}
+
+	public:
+
+		Address_map(Allocator &alloc)
+		:
+			_elements(&alloc),
+			_virt_pages(alloc, PAGE_SIZE_LOG2),
+			_virt_regions(alloc, REGION_SIZE_LOG2),
+			_phys_pages(alloc, PAGE_SIZE_LOG2),
+			_phys_regions(alloc, REGION_SIZE_LOG2)
+		{ }
+
 		bool add(Ram_dataspace_capability ds, void *va)
 		{
-			unsigned int index = 0;
-
-			while (index++ < ELEMENTS) {
-				if (!_map[index].valid) {
-					_map[index] = Address_map_element(index, ds, va);
-					return true;
-				}
-			};
-			return false;
+			Address_map_element *e = new (&_elements) Address_map_element(ds, va);
+			if (!e->size) {
+				destroy(&_elements, e);
+				return false;
+			}
+
+			(_large(e) ? _virt_regions : _virt_pages).insert((addr_t)e->virt, e->size, e);
+			(_large(e) ? _phys_regions : _phys_pages).insert((addr_t)e->phys, e->size, e);
+			return true;
 		}
 
-	struct Address_map_element *remove(void *va)
-	{
-		struct Address_map_element *am = get_by_virt (va);
-		if (am) {
-			_map[am->index].valid = false;
+		void remove(Address_map_element *e)
+		{
+			(_large(e) ? _virt_regions : _virt_pages).remove((addr_t)e->virt, e->size, e);
+			(_large(e) ? _phys_regions : _phys_pages).remove((addr_t)e->phys, e->size, e);
+			destroy(&_elements, e);
 		}
-		return (am);
-	}
-
-	struct Address_map_element *get_by_virt(void *va)
-	{
-		for (unsigned int i = 0; i < ELEMENTS; i++) {
-			if (_map[i].virt == va) {
-				return &_map[i];
-			}
+
+		/**
+		 * Look up element by virtual address, which may point into the buffer
+		 */
+		Address_map_element *get_by_virt(void *va)
+		{
+			return _lookup(_virt_regions, _virt_pages, va);
 		}
-		return nullptr;
-	}
-
-	struct Address_map_element *get_by_phys(void *pa)
-	{
-		for (unsigned int i = 0; i < ELEMENTS; i++) {
-			if (_map[i].phys == pa) {
-				return &_map[i];
-			}
+
+		/**
+		 * Look up element by physical address, which may point into the buffer
+		 */
+		Address_map_element *get_by_phys(void *pa)
+		{
+			return _lookup(_phys_regions, _phys_pages, pa);
 		}
-		return nullptr;
-	}
 };
 
-template <unsigned int ELEMENTS>
 class Genode::GPU_allocator : public Genode::Translation_table_allocator
 {
 	private:
 
-		int                   _index = 0;
 		Platform::Connection &_pci;
 		Genode::Env          &_env;
-		Address_map<ELEMENTS> _map;
+		Genode::Heap          _heap { _env.ram(), _env.rm() };
+		Address_map           _map  { _heap };
+
+	public:
+
+		enum Mode { DIRECT, POOL };
+
+	private:
+
+		Mode                  _mode;
+		Dma_pool              _pool { _heap };
+
+		/* Number of DMA buffers allocated from the platform driver */
+		unsigned long         _dma_buffers = 0;
+
+		Quota_manager        &_quota;
 
 		/**
 		 * Allocate DMA memory from the PCI driver
 		 */
-		Genode::Ram_dataspace_capability alloc_dma_memory(Genode::Env &env, Genode::size_t size)
+		Genode::Ram_dataspace_capability alloc_dma_memory(Genode::size_t size)
 		{
-			size_t donate = size;
-
-			return Genode::retry<Platform::Session::Out_of_metadata>(
-		        [&] () { return _pci.alloc_dma_buffer(size); },
-		        [&] () {
-					char quota[32];
-					Genode::snprintf(quota, sizeof(quota), "ram_quota=%zd", donate);
-					env.parent().upgrade(_pci.cap(), quota);
-					donate = donate * 2 > size ? 4096 : donate * 2;
-				});
+			return _quota.consume<Platform::Session::Out_of_metadata>(size,
+				[&] () { return _pci.alloc_dma_buffer(size); });
+		}
+
+		/**
+		 * Allocate DMA buffer and attach it to the local address space
+		 *
+		 * DMA buffers consist of whole pages. The page-rounded size is
+		 * accounted, which is the size released by 'free'.
+		 */
+		bool _alloc_buffer(size_t size, void **out_addr)
+		{
+			size = Genode::align_addr(size, 12);
+
+			Genode::Ram_dataspace_capability ds = alloc_dma_memory(size);
+			if (!ds.valid())
+				return false;
+
+			void *addr = _env.rm().attach(ds);
+
+			/* Without an entry, the buffer could never be freed */
+			if (!_map.add(ds, addr)) {
+				_env.rm().detach(addr);
+				_pci.free_dma_buffer(ds);
+				_quota.release(size);
+				return false;
+			}
+
+			_dma_buffers++;
+			event_trace().record (Event_trace::ALLOC, Event_trace::NO_ENGINE, 0, size);
+			*out_addr = addr;
+			return true;
 		}
 
 	public:
 
-		GPU_allocator(Genode::Env &env, Platform::Connection &pci)
-		: _pci(pci), _env(env)
+		/**
+		 * Constructor
+		 *
+		 * \param mode  in POOL mode, objects up to a page are carved from
+		 *              chunks of Dma_pool::CHUNK_SIZE bytes, larger objects
+		 *              are always separate DMA buffers
+		 */
+		GPU_allocator(Genode::Env &env, Platform::Connection &pci,
+		              Quota_manager &quota, Mode mode = DIRECT)
+		: _pci(pci), _env(env), _mode(mode), _quota(quota)
 		{
 		}
 
 		void free(void *addr, size_t size)
 		{
-			Address_map_element *m = _map.remove(addr);
-			if (m) {
+			if (_mode == POOL && _pool.free(addr))
+				return;
+
+			/* The lookup also matches interior pointers, free only whole buffers */
+			Address_map_element *m = _map.get_by_virt(addr);
+			if (m && m->virt == addr) {
 				_env.rm().detach(m->virt);
 				_pci.free_dma_buffer(m->ds_cap);
+				_quota.release(m->size);
+				_map.remove(m);
 			}
 		}
 
@@ -143,7 +226,7 @@ class Genode::GPU_allocator : public Genode::Translation_table_allocator
 		{
 			struct Address_map_element *m = _map.get_by_virt (addr);
 			if (m) {
-				return (void *)m->phys;
+				return (void *)((addr_t)m->phys + ((addr_t)addr - (addr_t)m->virt));
 			}
 			return nullptr;
 		}
@@ -152,20 +235,31 @@ class Genode::GPU_allocator : public Genode::Translation_table_allocator
 		{
 			struct Address_map_element *m = _map.get_by_phys (addr);
 			if (m) {
-				return (void *)m->virt;
+				return (void *)((addr_t)m->virt + ((addr_t)addr - (addr_t)m->phys));
 			}
 			return nullptr;
 		}
 
 		bool alloc(size_t size, void **out_addr)
 		{
-			Genode::Ram_dataspace_capability ds = alloc_dma_memory(_env, size);
-			if (!ds.valid())
-				return false;
+			if (_mode == DIRECT || !Dma_pool::fits(size))
+				return _alloc_buffer(size, out_addr);
+
+			void *obj = _pool.alloc(size);
+			if (!obj) {
+				void *chunk;
+				if (!_alloc_buffer(Dma_pool::CHUNK_SIZE, &chunk))
+					return false;
 
-			*out_addr = _env.rm().attach(ds);
-			return _map.add(ds, *out_addr);
+				_pool.add_chunk(chunk);
+				obj = _pool.alloc(size);
+			}
+
+			*out_addr = obj;
+			return obj != nullptr;
 		}
+
+		unsigned long dma_buffers() const { return _dma_buffers; }
 };
 
 #endif /* _GPU_ALLOCATOR_H_ */
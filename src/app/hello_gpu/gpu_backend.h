@@ -0,0 +1,146 @@
+/*
+ * \brief  Backend of the GPU service
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+/*
+ * The session component only validates client requests and keeps track of
+ * the client's buffers. Contexts and buffers are provided by a backend,
+ * which either drives the IGD or simulates it, so the service can be used
+ * without hardware.
+ */
+
+#ifndef _GPU_BACKEND_H_
+#define _GPU_BACKEND_H_
+
+#include <base/session_label.h>
+#include <base/signal.h>
+#include <gpu_session/gpu_session.h>
+
+namespace Gpu {
+
+	class Context;
+	struct Backend;
+}
+
+/*
+ * GPU context of a session
+ */
+class Gpu::Context
+{
+	private:
+
+		Genode::Signal_context_capability _sigh;
+
+	public:
+
+		virtual ~Context() { }
+
+		/**
+		 * Map 'size' bytes at physical address 'pa' to graphics address 'ga'
+		 */
+		virtual void map(addr_t ga, addr_t pa, size_t size, bool writeable) = 0;
+
+		virtual void unmap(addr_t ga, size_t size) = 0;
+
+		/**
+		 * Execute batch buffer at graphics address 'ga'
+		 *
+		 * \return  false if the ring is full
+		 */
+		virtual bool exec(addr_t ga, Session::Seqno &seqno) = 0;
+
+		/**
+		 * Sequence number of the last completed batch
+		 */
+		virtual Session::Seqno completed() const = 0;
+
+		/**
+		 * Set scheduling priority and weight relative to other contexts
+		 *
+		 * A weight of 0 selects the default weight. Ignored by backends that do not schedule contexts.
+		 */
+		virtual void schedule(unsigned priority, unsigned weight) { }
+
+		/**
+		 * Context ID, 0 for backends without hardware contexts
+		 */
+		virtual unsigned id() const { return 0; }
+
+		/**
+		 * GPU time consumed in context timestamp ticks
+		 *
+		 * Backends that do not account GPU time report 0.
+		 */
+		virtual Genode::uint64_t runtime() const { return 0; }
+
+		/**
+		 * ID of the context in OA performance counter reports, 0 for
+		 * backends without hardware contexts
+		 */
+		virtual Genode::uint32_t oa_context_id() const { return 0; }
+
+		void completion_sigh(Genode::Signal_context_capability sigh) { _sigh = sigh; }
+
+		/**
+		 * Signal completion of batches to the session's client
+		 */
+		void notify()
+		{
+			if (_sigh.valid())
+				Genode::Signal_transmitter(_sigh).submit();
+		}
+};
+
+struct Gpu::Backend
+{
+	class Out_of_contexts : public Genode::Exception { };
+
+	virtual ~Backend() { }
+
+	/**
+	 * \param label  client label, contexts of the same label share the
+	 *               client's scheduling weight
+	 *
+	 * \throw Out_of_contexts
+	 */
+	virtual Context &alloc_context(Genode::Session_label const &label) = 0;
+
+	/**
+	 * Release context of a closed session
+	 *
+	 * The context is destroyed once its batches completed and all of
+	 * its retired buffers were freed.
+	 */
+	virtual void free_context(Context &) = 0;
+
+	/**
+	 * Allocate buffer
+	 *
+	 * \return  invalid capability if no memory is available
+	 */
+	virtual Genode::Ram_dataspace_capability alloc_buffer(size_t size) = 0;
+
+	virtual void free_buffer(Genode::Ram_dataspace_capability ds) = 0;
+
+	/**
+	 * Unmap and free buffer once the GPU is done with it
+	 *
+	 * The 'size' bytes mapped at 'ga' of 'context' are unmapped and 'ds' is
+	 * freed after all batches executed by the context so far completed.
+	 * The TLBs are invalidated before the memory is reused. The caller does
+	 * not wait for that. An invalid 'ds' only unmaps, a 'size' of 0 only
+	 * frees.
+	 */
+	virtual void retire_buffer(Context &context, Genode::Ram_dataspace_capability ds,
+	                           addr_t ga, size_t size) = 0;
+
+	/**
+	 * True if a retired range of 'context' overlapping 'ga' and 'size' is
+	 * not unmapped yet, the range must not be mapped again before
+	 */
+	virtual bool unmapping(Context &context, addr_t ga, size_t size) = 0;
+};
+
+#endif /* _GPU_BACKEND_H_ */
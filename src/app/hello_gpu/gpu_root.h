@@ -0,0 +1,386 @@
+/*
+ * \brief  GPU service
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+/*
+ * A session component tracks the buffers of its client and checks every
+ * request against them, so a client can only map and execute its own
+ * buffers. Buffer memory and the session's metadata are accounted to the
+ * quota donated by the client.
+ *
+ * Buffers are unmapped and freed by the backend only after all batches of
+ * their session completed, as the GPU may still access them otherwise.
+ * Neither unmapping or freeing a buffer nor closing a session waits for
+ * that. Until then, the unmapped range cannot be mapped again.
+ *
+ * The scheduling priority and weight of a session's context are taken from
+ * the session policy matching the client's label. All sessions of a client
+ * share its weight:
+ *
+ * <config>
+ * 	<policy label="interactive" priority="1"/>
+ * 	<policy label="batch" weight="512"/>
+ * </config>
+ *
+ * The GPU time consumed by the context of each session is reported by
+ * 'Root::gpu_time', per session and summed up per client label. The totals
+ * of a client include the sessions it already closed. The report also names
+ * the ID of each session's context in OA reports, e.g., to filter OA
+ * counters by session.
+ */
+
+#ifndef _GPU_ROOT_H_
+#define _GPU_ROOT_H_
+
+#include <base/rpc_server.h>
+#include <base/session_label.h>
+#include <dataspace/client.h>
+#include <os/session_policy.h>
+#include <root/component.h>
+#include <util/arg_string.h>
+#include <util/list.h>
+#include <util/misc_math.h>
+#include <util/xml_generator.h>
+
+#include <gpu_backend.h>
+
+namespace Gpu {
+
+	class Session_component;
+	class Root;
+}
+
+class Gpu::Session_component : public Genode::Rpc_object<Gpu::Session>,
+                               public Genode::List<Session_component>::Element
+{
+	private:
+
+		enum {
+			PAGE_SIZE_LOG2 = 12,
+			PAGE_SIZE      = 1UL << PAGE_SIZE_LOG2,
+			ADDRESS_LIMIT  = 1UL << 48
+		};
+
+		struct Buffer : Genode::List<Buffer>::Element
+		{
+			Genode::Ram_dataspace_capability const ds;
+
+			addr_t const pa;
+			size_t const size;
+
+			addr_t ga     = 0;
+			bool   mapped = false;
+
+			Buffer(Genode::Ram_dataspace_capability ds)
+			:
+				ds (ds),
+				pa (Genode::Dataspace_client (ds).phys_addr()),
+				size (Genode::Dataspace_client (ds).size())
+			{ }
+
+			bool contains(addr_t addr) const {
+				return mapped && addr >= ga && addr < ga + size; }
+
+			bool overlaps(addr_t base, size_t len) const {
+				return mapped && base < ga + size && ga < base + len; }
+		};
+
+		Genode::Session_label const _label;
+
+		Genode::Allocator    &_md_alloc;
+		Backend              &_backend;
+		Context              &_context;
+		size_t                _ram_quota;
+		size_t                _consumed = 0;
+		Genode::List<Buffer>  _buffers;
+
+		/*
+		 * Account 'size' bytes to the session quota
+		 */
+		void _consume(size_t size)
+		{
+			if (_consumed + size > _ram_quota)
+				throw Out_of_metadata();
+
+			_consumed += size;
+		}
+
+		Buffer *_lookup(Genode::Ram_dataspace_capability ds)
+		{
+			for (Buffer *b = _buffers.first(); b; b = b->next())
+				if (b->ds == ds)
+					return b;
+			return nullptr;
+		}
+
+		void _unmap(Buffer &b)
+		{
+			if (!b.mapped)
+				return;
+
+			_backend.retire_buffer (_context, Genode::Ram_dataspace_capability(),
+			                        b.ga, b.size);
+			b.mapped = false;
+		}
+
+		/*
+		 * Batches may access the buffer even if it is unmapped, as its
+		 * unmapping may still be pending
+		 */
+		void _free(Buffer &b)
+		{
+			if (b.mapped)
+				_backend.retire_buffer (_context, b.ds, b.ga, b.size);
+			else
+				_backend.retire_buffer (_context, b.ds, 0, 0);
+
+			_buffers.remove (&b);
+
+			_consumed -= b.size + sizeof(Buffer);
+			Genode::destroy (&_md_alloc, &b);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param ram_quota  quota available for buffers and their metadata
+		 */
+		Session_component(Genode::Session_label const &label,
+		                  Genode::Allocator &md_alloc, Backend &backend, size_t ram_quota)
+		:
+			_label (label), _md_alloc (md_alloc), _backend (backend),
+			_context (backend.alloc_context (label)), _ram_quota (ram_quota)
+		{ }
+
+		~Session_component()
+		{
+			while (Buffer *b = _buffers.first())
+				_free (*b);
+
+			_backend.free_context (_context);
+		}
+
+		void upgrade(size_t ram_quota) { _ram_quota += ram_quota; }
+
+		void schedule(unsigned priority, unsigned weight) {
+			_context.schedule (priority, weight); }
+
+		Genode::Session_label const &label() const { return _label; }
+
+		Context const &context() const { return _context; }
+
+
+		/***************************
+		 ** Gpu session interface **
+		 ***************************/
+
+		Genode::Ram_dataspace_capability alloc_buffer(size_t size) override
+		{
+			size = Genode::align_addr (size, PAGE_SIZE_LOG2);
+			_consume (size + sizeof(Buffer));
+
+			Genode::Ram_dataspace_capability ds = _backend.alloc_buffer (size);
+			if (!ds.valid()) {
+				_consumed -= size + sizeof(Buffer);
+				throw Out_of_metadata();
+			}
+
+			_buffers.insert (new (&_md_alloc) Buffer (ds));
+			return ds;
+		}
+
+		void free_buffer(Genode::Ram_dataspace_capability ds) override
+		{
+			Buffer *b = _lookup (ds);
+			if (b)
+				_free (*b);
+		}
+
+		void map_buffer(Genode::Ram_dataspace_capability ds, addr_t ga, bool writeable) override
+		{
+			Buffer *b = _lookup (ds);
+			if (!b || b->mapped)
+				throw Invalid_buffer();
+
+			if ((ga & (PAGE_SIZE - 1)) || ga < RESERVED_SIZE ||
+			    ga + b->size > ADDRESS_LIMIT || ga + b->size < ga)
+				throw Invalid_buffer();
+
+			for (Buffer *o = _buffers.first(); o; o = o->next())
+				if (o->overlaps (ga, b->size))
+					throw Invalid_buffer();
+
+			if (_backend.unmapping (_context, ga, b->size))
+				throw Invalid_buffer();
+
+			_context.map (ga, b->pa, b->size, writeable);
+			b->ga     = ga;
+			b->mapped = true;
+		}
+
+		void unmap_buffer(Genode::Ram_dataspace_capability ds) override
+		{
+			Buffer *b = _lookup (ds);
+			if (b)
+				_unmap (*b);
+		}
+
+		Seqno exec_buffer(addr_t ga) override
+		{
+			bool mapped = false;
+			for (Buffer *b = _buffers.first(); b && !mapped; b = b->next())
+				mapped = b->contains (ga);
+
+			if (!mapped)
+				throw Invalid_buffer();
+
+			Seqno seqno;
+			if (!_context.exec (ga, seqno))
+				throw Ring_full();
+
+			return seqno;
+		}
+
+		Seqno completed() override { return _context.completed(); }
+
+		void completion_sigh(Genode::Signal_context_capability sigh) override {
+			_context.completion_sigh (sigh); }
+};
+
+class Gpu::Root : public Genode::Root_component<Session_component>
+{
+	private:
+
+		Backend &_backend;
+
+		Genode::List<Session_component> _sessions;
+
+		/*
+		 * GPU time of the closed sessions of a client
+		 *
+		 * Entries are kept for the lifetime of the root, so the totals
+		 * survive the sessions.
+		 */
+		struct Client : Genode::List<Client>::Element
+		{
+			Genode::Session_label const label;
+			Genode::uint64_t            closed_runtime = 0;
+
+			Client(Genode::Session_label const &label) : label (label) { }
+		};
+
+		Genode::List<Client> _clients;
+
+		Client &_client(Genode::Session_label const &label)
+		{
+			for (Client *c = _clients.first(); c; c = c->next())
+				if (c->label == label)
+					return *c;
+
+			Client *c = new (md_alloc()) Client (label);
+			_clients.insert (c);
+			return *c;
+		}
+
+		static size_t _ram_quota(char const *args) {
+			return Genode::Arg_string::find_arg (args, "ram_quota").ulong_value (0); }
+
+	protected:
+
+		Session_component *_create_session(char const *args) override
+		{
+			size_t const ram_quota = _ram_quota (args);
+
+			if (ram_quota < sizeof(Session_component))
+				throw Genode::Root::Quota_exceeded();
+
+			Session_component *session = nullptr;
+			try {
+				session = new (md_alloc())
+					Session_component (Genode::label_from_args (args),
+					                   *md_alloc(), _backend,
+					                   ram_quota - sizeof(Session_component));
+			} catch (Backend::Out_of_contexts) {
+				throw Genode::Root::Unavailable();
+			}
+
+			try {
+				Genode::Session_policy policy (Genode::label_from_args (args));
+				session->schedule (policy.attribute_value ("priority", 0U),
+				                   policy.attribute_value ("weight",   0U));
+			} catch (Genode::Session_policy::No_policy_defined) { }
+
+			_client (session->label());
+			_sessions.insert (session);
+			return session;
+		}
+
+		void _upgrade_session(Session_component *session, char const *args) override
+		{
+			session->upgrade (_ram_quota (args));
+		}
+
+		void _destroy_session(Session_component *session) override
+		{
+			_client (session->label()).closed_runtime += session->context().runtime();
+
+			_sessions.remove (session);
+			Genode::Root_component<Session_component>::_destroy_session (session);
+		}
+
+	public:
+
+		Root(Genode::Env &env, Genode::Allocator &md_alloc, Backend &backend)
+		:
+			Genode::Root_component<Session_component> (env.ep(), md_alloc),
+			_backend (backend)
+		{ }
+
+		/**
+		 * Generate report of the GPU time of all open sessions and clients
+		 *
+		 * Times are given in context timestamp ticks and, converted by the
+		 * timestamp frequency 'timestamp_khz', in microseconds.
+		 */
+		void gpu_time(Genode::Xml_generator &xml, unsigned long timestamp_khz)
+		{
+			if (!timestamp_khz)
+				timestamp_khz = 1;
+
+			auto us = [&] (Genode::uint64_t runtime) {
+				return (unsigned long)(runtime * 1000 / timestamp_khz); };
+
+			for (Session_component *s = _sessions.first(); s; s = s->next())
+				xml.node ("context", [&] () {
+					xml.attribute ("id",         (unsigned long)s->context().id());
+					xml.attribute ("label",      s->label().string());
+					xml.attribute ("runtime",    (unsigned long)s->context().runtime());
+					xml.attribute ("runtime_us", us (s->context().runtime()));
+					xml.attribute ("oa_context", (unsigned long)s->context().oa_context_id());
+				});
+
+			for (Client *c = _clients.first(); c; c = c->next()) {
+
+				Genode::uint64_t runtime  = c->closed_runtime;
+				unsigned         contexts = 0;
+				for (Session_component *s = _sessions.first(); s; s = s->next())
+					if (s->label() == c->label) {
+						runtime += s->context().runtime();
+						contexts++;
+					}
+
+				xml.node ("client", [&] () {
+					xml.attribute ("label",      c->label.string());
+					xml.attribute ("contexts",   (unsigned long)contexts);
+					xml.attribute ("runtime",    (unsigned long)runtime);
+					xml.attribute ("runtime_us", us (runtime));
+				});
+			}
+		}
+};
+
+#endif /* _GPU_ROOT_H_ */
@@ -0,0 +1,363 @@
+/*
+ * \brief  GPU service backend driving the IGD
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+/*
+ * Every session gets a render context of its own, which is scheduled on the
+ * execlist port of the RCS by the engine's scheduler. Contexts come from the
+ * context pool, so creating one for a new session is cheap. The context of
+ * a closed session is retired until the scheduler released it, i.e., the
+ * GPU switched it out, and then returned to the pool. Buffers are DMA
+ * buffers of the platform driver, which are accounted by the quota manager.
+ *
+ * The contexts of all sessions of a client form one weight group, so the
+ * client's weight is shared among its sessions.
+ *
+ * Unmapped and freed buffers are retired as well, as batches may still
+ * access them. They are unmapped once the context's fence passed the last
+ * batch executed before, and freed after the RCS TLBs were invalidated.
+ * Retired buffers and contexts are reaped on context completion events, so
+ * no RPC of a client ever waits for the GPU.
+ */
+
+#ifndef _HW_BACKEND_H_
+#define _HW_BACKEND_H_
+
+#include <base/log.h>
+#include <dataspace/client.h>
+#include <platform_session/connection.h>
+#include <util/bit_allocator.h>
+#include <util/list.h>
+
+#include <context_pool.h>
+#include <gpu_backend.h>
+#include <quota.h>
+#include <scheduler.h>
+#include <submission.h>
+
+namespace Gpu {
+
+	class Hw_context;
+	class Hw_backend;
+}
+
+class Gpu::Hw_context : public Gpu::Context,
+                        public Genode::List<Hw_context>::Element
+{
+	private:
+
+		enum { RING_ELEMENTS = 100 };
+
+		Genode::Submission          _submission;
+		Genode::Execlist_scheduler &_scheduler;
+
+	public:
+
+		Hw_context(Genode::Translation_table_allocator &allocator,
+		           Genode::Context_pool &pool, Genode::IGD &igd,
+		           Genode::Execlist_scheduler &scheduler, unsigned id,
+		           Genode::Weight_group &group)
+		:
+			_submission (&allocator, pool, igd, scheduler.engine(), RING_ELEMENTS, id),
+			_scheduler (scheduler)
+		{
+			_submission.group (group);
+		}
+
+		unsigned id() const override { return _submission.id(); }
+
+		/**
+		 * True if the context can be destroyed
+		 */
+		bool released() { return !_scheduler.holds (_submission); }
+
+		void map(addr_t ga, addr_t pa, size_t size, bool writeable) override
+		{
+			Genode::Page_flags const flags = Genode::Page_flags
+				{ .writeable  = writeable,
+				  .executable = true,
+				  .privileged = true,
+				  .global     = false,
+				  .device     = false,
+				  .cacheable  = Genode::UNCACHED };
+
+			_submission.insert_translation (ga, pa, size, flags);
+		}
+
+		void unmap(addr_t ga, size_t size) override
+		{
+			_submission.remove_translation (ga, size);
+		}
+
+		bool exec(addr_t ga, Session::Seqno &seqno) override
+		{
+			if (!_submission.insert (ga))
+				return false;
+
+			seqno = _submission.seqno();
+			_scheduler.submit (_submission);
+			return true;
+		}
+
+		Session::Seqno completed() const override { return _submission.fence().completed(); }
+
+		/**
+		 * Sequence number of the last batch executed
+		 */
+		Session::Seqno submitted() const { return _submission.seqno(); }
+
+		bool signaled(Session::Seqno seqno) const { return _submission.fence().signaled (seqno); }
+
+		void schedule(unsigned priority, unsigned weight) override {
+			_submission.schedule (priority, weight); }
+
+		Genode::uint64_t runtime() const override { return _submission.runtime(); }
+
+		Genode::uint32_t oa_context_id() const override { return _submission.oa_context_id(); }
+};
+
+class Gpu::Hw_backend : public Gpu::Backend
+{
+	private:
+
+		Platform::Connection                &_pci;
+		Genode::Quota_manager               &_quota;
+		Genode::Translation_table_allocator &_allocator;
+		Genode::Context_pool                &_pool;
+		Genode::IGD                         &_igd;
+		Genode::Execlist_scheduler          &_scheduler;
+		Genode::Allocator                   &_md_alloc;
+
+		enum { MAX_CONTEXTS = 1024 };
+
+		unsigned const                      _first_id;
+		Genode::Bit_allocator<MAX_CONTEXTS> _ids;
+
+		Genode::List<Hw_context> _active;
+		Genode::List<Hw_context> _retired;
+
+		/*
+		 * Weight group of all contexts of a client
+		 */
+		struct Client : Genode::Weight_group, Genode::List<Client>::Element
+		{
+			Genode::Session_label const label;
+
+			Client(Genode::Session_label const &label)
+			: Weight_group (Genode::Submission::DEFAULT_WEIGHT), label (label) { }
+		};
+
+		Genode::List<Client> _clients;
+
+		Client &_client(Genode::Session_label const &label)
+		{
+			for (Client *c = _clients.first(); c; c = c->next())
+				if (c->label == label)
+					return *c;
+
+			Client *c = new (&_md_alloc) Client (label);
+			_clients.insert (c);
+			return *c;
+		}
+
+		void _release_clients()
+		{
+			for (Client *c = _clients.first(), *next; c; c = next) {
+				next = c->next();
+
+				if (c->members)
+					continue;
+
+				_clients.remove (c);
+				Genode::destroy (&_md_alloc, c);
+			}
+		}
+
+		/*
+		 * Range to unmap and buffer to free, 'size' is 0 once unmapped and
+		 * 'ds' is invalid if only the range is retired
+		 */
+		struct Retired_buffer : Genode::List<Retired_buffer>::Element
+		{
+			Hw_context                       &context;
+			Genode::Ram_dataspace_capability  ds;
+			addr_t                            ga;
+			size_t                            size;
+			Session::Seqno                    seqno;
+
+			Retired_buffer(Hw_context &context, Genode::Ram_dataspace_capability ds,
+			               addr_t ga, size_t size)
+			:
+				context (context), ds (ds), ga (ga), size (size),
+				seqno (context.submitted())
+			{ }
+		};
+
+		Genode::List<Retired_buffer> _retired_buffers;
+
+		bool _buffers_retired(Hw_context &c)
+		{
+			for (Retired_buffer *b = _retired_buffers.first(); b; b = b->next())
+				if (&b->context == &c)
+					return true;
+			return false;
+		}
+
+		/* Entries were removed from the PPGTT since the last TLB invalidation */
+		bool _tlb_stale = false;
+
+		/*
+		 * Free retired buffers the GPU is done with and destroy retired
+		 * contexts the GPU switched out
+		 *
+		 * The engine may still cache translations of unmapped ranges, so
+		 * memory is only freed after invalidating its TLBs.
+		 */
+		void _reap()
+		{
+			for (Retired_buffer *b = _retired_buffers.first(); b; b = b->next()) {
+
+				if (!b->size || !b->context.signaled (b->seqno))
+					continue;
+
+				b->context.unmap (b->ga, b->size);
+				b->size    = 0;
+				_tlb_stale = true;
+			}
+
+			if (_tlb_stale && _igd.invalidate_tlb (_scheduler.engine()))
+				_tlb_stale = false;
+
+			for (Retired_buffer *b = _retired_buffers.first(), *next; b; b = next) {
+				next = b->next();
+
+				if (_tlb_stale || b->size || !b->context.signaled (b->seqno))
+					continue;
+
+				if (b->ds.valid())
+					free_buffer (b->ds);
+
+				_retired_buffers.remove (b);
+				Genode::destroy (&_md_alloc, b);
+			}
+
+			if (_tlb_stale)
+				Genode::error ("TLB invalidation timed out, retired buffers kept");
+
+			for (Hw_context *c = _retired.first(), *next; c; c = next) {
+				next = c->next();
+
+				if (!c->released() || _buffers_retired (*c))
+					continue;
+
+				_retired.remove (c);
+				_ids.free (c->id() - _first_id);
+				Genode::destroy (&_md_alloc, c);
+			}
+
+			_release_clients();
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param scheduler  scheduler of the engine used by all sessions
+		 * \param first_id   first context ID not used by other submissions
+		 */
+		Hw_backend(Platform::Connection                &pci,
+		           Genode::Quota_manager               &quota,
+		           Genode::Translation_table_allocator &allocator,
+		           Genode::Context_pool                &pool,
+		           Genode::IGD                         &igd,
+		           Genode::Execlist_scheduler          &scheduler,
+		           Genode::Allocator                   &md_alloc,
+		           unsigned                             first_id)
+		:
+			_pci (pci), _quota (quota), _allocator (allocator), _pool (pool),
+			_igd (igd), _scheduler (scheduler), _md_alloc (md_alloc),
+			_first_id (first_id)
+		{ }
+
+		/**
+		 * Context with ID 'id' completed on the engine
+		 */
+		void context_complete(unsigned id)
+		{
+			for (Hw_context *c = _active.first(); c; c = c->next())
+				if (c->id() == id)
+					c->notify();
+
+			_reap();
+		}
+
+		Context &alloc_context(Genode::Session_label const &label) override
+		{
+			_reap();
+
+			unsigned id;
+			try {
+				id = _first_id + _ids.alloc();
+			} catch (Genode::Bit_allocator<MAX_CONTEXTS>::Out_of_indices) {
+				throw Out_of_contexts();
+			}
+
+			Hw_context *c = new (&_md_alloc)
+				Hw_context (_allocator, _pool, _igd, _scheduler, id, _client (label));
+
+			_active.insert (c);
+			return *c;
+		}
+
+		void free_context(Context &context) override
+		{
+			Hw_context &c = static_cast<Hw_context &>(context);
+
+			_active.remove (&c);
+			_retired.insert (&c);
+			_reap();
+		}
+
+		/* The page-rounded size is accounted, as released by 'free_buffer' */
+		Genode::Ram_dataspace_capability alloc_buffer(size_t size) override
+		{
+			size = Genode::align_addr (size, 12);
+
+			return _quota.consume<Platform::Session::Out_of_metadata>(size,
+				[&] () { return _pci.alloc_dma_buffer (size); });
+		}
+
+		void free_buffer(Genode::Ram_dataspace_capability ds) override
+		{
+			size_t const size = Genode::Dataspace_client (ds).size();
+
+			_pci.free_dma_buffer (ds);
+			_quota.release (size);
+		}
+
+		void retire_buffer(Context &context, Genode::Ram_dataspace_capability ds,
+		                   addr_t ga, size_t size) override
+		{
+			Hw_context &c = static_cast<Hw_context &>(context);
+
+			_retired_buffers.insert (new (&_md_alloc) Retired_buffer (c, ds, ga, size));
+			_reap();
+		}
+
+		bool unmapping(Context &context, addr_t ga, size_t size) override
+		{
+			_reap();
+
+			for (Retired_buffer *b = _retired_buffers.first(); b; b = b->next())
+				if (&b->context == &context && b->size &&
+				    ga < b->ga + b->size && b->ga < ga + size)
+					return true;
+
+			return false;
+		}
+};
+
+#endif /* _HW_BACKEND_H_ */
@@ -10,6 +10,9 @@
 #include <util/mmio.h>
 #include <context.h>
 #include <descriptor.h>
+#include <context_status.h>
+#include <engine.h>
+#include <event_trace.h>
 
 namespace Genode {
 
@@ -18,9 +21,7 @@ namespace Genode {
 
 class Genode::IGD : public Mmio
 {
-	uint64_t *_gtt;
-
-	struct Execlist_submitport : Register<0x2230, 32> { };
+	uint64_t volatile *_gtt;
 
 	struct FAULT_REG : Register<0x4094, 32>
 	{
@@ -174,63 +175,367 @@ class Genode::IGD : public Mmio
 
 	struct RP_CONTROL : Register<0xa024, 32> { };
 
-	struct RCS_RING_CONTEXT_STATUS_PTR : Register<0x23a0, 32> { };
+	struct MASTER_INT_CTL : Register<0x44200, 32>
+	{
+		struct Master_interrupt_enable : Bitfield<31, 1> { };
+		struct Gt_0_interrupt_pending  : Bitfield< 0, 1> { };
+	};
+
+	/*
+	 * GT interrupt registers of the four banks, one 16 byte block per bank
+	 * starting at GT_0. The arrays are indexed by '_gt_bank (bank)'.
+	 */
+	enum {
+		GT_INTERRUPT_BANK_SIZE = 0x10,
+		GT_INTERRUPT_BANKS     = 4,
+		GT_INTERRUPT_ITEMS     = (GT_INTERRUPT_BANKS - 1) * GT_INTERRUPT_BANK_SIZE / 4 + 1,
+	};
+
+	struct GT_INTERRUPT_ISR : Register_array<0x44300, 32, GT_INTERRUPT_ITEMS, 32> { };
+	struct GT_INTERRUPT_IMR : Register_array<0x44304, 32, GT_INTERRUPT_ITEMS, 32> { };
+	struct GT_INTERRUPT_IIR : Register_array<0x44308, 32, GT_INTERRUPT_ITEMS, 32> { };
+	struct GT_INTERRUPT_IER : Register_array<0x4430C, 32, GT_INTERRUPT_ITEMS, 32> { };
+
+	/* Bits of an engine within the GT interrupt registers */
+	struct Engine_interrupt : Genode::Register<32>
+	{
+		struct User_interrupt : Bitfield< 0, 1> { };
+		struct Context_switch : Bitfield< 8, 1> { };
+	};
+
+	/*
+	 * Engine registers
+	 *
+	 * All engines have the same register layout relative to their ring
+	 * base. Every register is an array of dwords starting at its RCS
+	 * instance, the instance of an engine is selected by '_ring (e)'.
+	 */
+	enum { RING_ITEMS = (0x22000 - 0x2000) / 4 + 1 };
+
+	struct RING_HWS_PGA            : Register_array<0x2080, 32, RING_ITEMS, 32> { };
+	struct RING_IMR                : Register_array<0x20a8, 32, RING_ITEMS, 32> { };
+	struct RING_ELSP               : Register_array<0x2230, 32, RING_ITEMS, 32> { };
+	struct RING_EXECLIST_STATUS_HI : Register_array<0x2238, 32, RING_ITEMS, 32> { };
+	struct RING_CTX_TIMESTAMP      : Register_array<0x23a8, 32, RING_ITEMS, 32> { };
+
+	struct RING_MODE : Register_array<0x229c, 32, RING_ITEMS, 32>
+	{
+		struct Execlist_enable_mask : Bitfield<31, 1> { };
+		struct Execlist_enable      : Bitfield<15, 1> { };
+	};
+
+	struct RING_CONTEXT_STATUS_PTR : Register_array<0x23a0, 32, RING_ITEMS, 32>
+	{
+		struct Read_pointer_mask  : Bitfield<24, 3> { };
+		struct Read_pointer       : Bitfield< 8, 3> { };
+		struct Write_pointer      : Bitfield< 0, 3> { };
+	};
+
+	/* Invalidate GGTT TLBs */
+	struct GFX_FLSH_CNTL : Register<0x101008, 32>
+	{
+		struct Enable : Bitfield<0, 1> { };
+	};
+
+	/*
+	 * Invalidate the TLBs of an engine, the bit is cleared by the engine
+	 * when done. Indexed by 'tlb_control'.
+	 */
+	struct TLB_CONTROL : Register_array<0x4260, 32, 5, 32>
+	{
+		struct Invalidate : Bitfield<0, 1> { };
+	};
+
+	/*
+	 * Observation architecture (OA) unit, Gen8 layout
+	 *
+	 * OACTXCONTROL and the flexible EU counter registers are saved in and
+	 * restored from the RCS context image. They are only programmed before
+	 * the first RCS context is submitted: their values then end up in
+	 * every saved image, and new images are loaded with restore inhibited.
+	 * Patching them into images that already exist is not supported.
+	 */
+	struct OACTXCONTROL : Register<0x2360, 32>
+	{
+		struct Timer_period   : Bitfield<2, 6> { };
+		struct Timer_enable   : Bitfield<1, 1> { };
+		struct Counter_resume : Bitfield<0, 1> { };
+	};
+
+	struct OACTXID : Register<0x2364, 32> { };
+
+	struct OABUFFER_UDW : Register<0x23b4, 32> { };
+
+	struct OACONTROL : Register<0x2b00, 32>
+	{
+		struct Report_format           : Bitfield<2, 3> { };
+		struct Specific_context_enable : Bitfield<1, 1> { };
+		struct Counter_enable          : Bitfield<0, 1> { };
+	};
+
+	struct OASTATUS : Register<0x2b08, 32>
+	{
+		struct Overrun          : Bitfield<3, 1> { };
+		struct Counter_overflow : Bitfield<2, 1> { };
+		struct Buffer_overflow  : Bitfield<1, 1> { };
+		struct Report_lost      : Bitfield<0, 1> { };
+	};
+
+	/* Head and tail are graphics addresses within the buffer */
+	struct OAHEADPTR : Register<0x2b0c, 32>
+	{
+		struct Address : Bitfield<6, 26> { };
+	};
+
+	struct OATAILPTR : Register<0x2b10, 32>
+	{
+		struct Address : Bitfield<6, 26> { };
+	};
+
+	struct OABUFFER : Register<0x2b14, 32>
+	{
+		struct Address       : Bitfield<6, 26> { };
+		struct Size          : Bitfield<3,  3> { }; /* 128 KiB << Size */
+		struct Memory_select : Bitfield<0,  1> { enum { GGTT = 1 }; };
+	};
+
+	public:
+
+		/*
+		 * Model of the command streamers
+		 *
+		 * A simulated IGD has no hardware behind its submit ports. If a
+		 * model is set, it receives execlist submissions and engine setups
+		 * after the registers were written.
+		 */
+		struct Engine_model
+		{
+			virtual void setup(Engine, addr_t hwsp) = 0;
+			virtual void submit(Engine, Context_descriptor element0,
+			                    Context_descriptor element1) = 0;
+			virtual void invalidate_tlb(Engine) = 0;
+		};
+
+		/**
+		 * Offset of the TLB control register of engine 'e'
+		 */
+		static addr_t tlb_control(Engine e)
+		{
+			return TLB_CONTROL::OFFSET + 4 * (e == RCS  ? 0 :
+			                                  e == VCS0 ? 1 :
+			                                  e == VCS1 ? 2 :
+			                                  e == BCS  ? 3 :
+			                                              4);
+		}
 
 	private:
 
+		Engine_model *_model = nullptr;
+
+		/*
+		 * MMIO writes are posted, i.e., the CPU continues before they reached
+		 * the device. Any read from the device completes all preceding
+		 * writes, but reads are uncached and expensive. Every write therefore
+		 * uses one of the following policies:
+		 *
+		 * - posted:   plain write, if the effect is observed asynchronously
+		 *             anyway
+		 * - grouped:  sequence of posted writes completed by a single
+		 *             trailing posting read
+		 * - verified: write followed by a read-back of the same register
+		 */
+
+		unsigned _group = 0;
+
+		unsigned long _posting_reads = 0;
+
+		/*
+		 * MASTER_INT_CTL is always powered and reading it has no side
+		 * effects
+		 */
+		void _posting_read()
+		{
+			_posting_reads++;
+			(void)read<MASTER_INT_CTL>();
+		}
+
 		template <typename T>
-		inline void
-		write_reg (typename T::access_t const value)
+		void _write_posted(typename T::access_t const value)
 		{
 			write<T>(value);
-			(void)read<T>;
 		}
 
 		template <typename T>
-		inline void
-		write_reg (typename T::Bitfield_base::Compound_reg::access_t const value)
+		void _write_posted(typename T::Bitfield_base::Compound_reg::access_t const value)
 		{
 			write<T>(value);
-			(void)read<T>;
 		}
 
-	public:
+		template <typename T>
+		void _write_posted(typename T::Register_array_base::access_t const value,
+		                   unsigned long const index)
+		{
+			write<T>(value, index);
+		}
+
+		/**
+		 * Write register and read it back
+		 *
+		 * \return  true if the register holds the written value
+		 */
+		template <typename T>
+		bool _write_verified(typename T::access_t const value)
+		{
+			write<T>(value);
+			_posting_reads++;
+			return read<T>() == value;
+		}
+
+		template <typename T>
+		bool _write_verified(typename T::Register_array_base::access_t const value,
+		                     unsigned long const index)
+		{
+			write<T>(value, index);
+			_posting_reads++;
+			return read<T>(index) == value;
+		}
+
+		/**
+		 * Call 'fn' and complete all writes done by it with one posting read
+		 *
+		 * Groups may be nested, only the outermost one reads.
+		 */
+		template <typename FUNC>
+		void _write_grouped(FUNC const &fn)
+		{
+			_group++;
+			fn();
+			if (--_group == 0)
+				_posting_read();
+		}
+
+		uint32_t volatile *_reg(addr_t offset)
+		{
+			return (uint32_t volatile *)(base + offset);
+		}
+
+		/* Index of the engine's instance of a RING_* register */
+		static unsigned long _ring(Engine e)
+		{
+			return (ring_base(e) - ring_base(RCS)) / 4;
+		}
+
+		/* Index of the bank's instance of a GT_INTERRUPT_* register */
+		static unsigned long _gt_bank(unsigned bank)
+		{
+			return bank * GT_INTERRUPT_BANK_SIZE / 4;
+		}
+
+		/* Engines that accepted their hardware status page */
+		bool _present[NUM_ENGINES] = { };
+
+		/* An RCS context was submitted, its image holds the OA context registers */
+		bool _rcs_submitted = false;
+
+		/*
+		 * OA trigger and NOA configuration registers, not part of a context
+		 */
+		static bool _oa_global_register(addr_t offset)
+		{
+			return (offset >= 0x2710 && offset < 0x2800) ||
+			       (offset >= 0x9800 && offset < 0xa000);
+		}
 
-		IGD(Genode::Env &env, addr_t const base, addr_t const hwsp) : Mmio(base)
+		/*
+		 * Flexible EU counter configuration, saved in the RCS context
+		 */
+		static bool _oa_context_register(addr_t offset)
 		{
-			_gtt = (uint64_t *)(base + 0x800000);
+			return offset == 0xe458 || offset == 0xe558 || offset == 0xe658 ||
+			       offset == 0xe758 || offset == 0xe45c || offset == 0xe55c ||
+			       offset == 0xe65c;
+		}
+
+	public:
+
+		/* GGTT entries in the upper half of BAR0 */
+		enum { GTT_OFFSET = 0x800000 };
 
-			/* Disable DC state */
-			write_reg<DC_STATE_EN>(0);
+		IGD(Genode::Env &env, addr_t const base) : Mmio(base)
+		{
+			_gtt = (uint64_t volatile *)(base + GTT_OFFSET);
 
-			/* Enable PCH handshake */
-			write_reg<NDE_RSTWRN_OPT::Rst_pch_handshake_en>(1);
+			_write_grouped ([&] () {
 
-			/* Disable RC6 state (may have been enabled by BIOS */
-			write_reg<RC_STATE::RC6_STATE>(1);
+				/* Disable DC state */
+				_write_posted<DC_STATE_EN>(0);
 
-			/* Disable RC states, power gating and RP (?) */
-			write_reg<RC_CONTROL>(0);
-			write_reg<PG_ENABLE>(0);
-			write_reg<RP_CONTROL>(0);
+				/* Enable PCH handshake */
+				_write_posted<NDE_RSTWRN_OPT::Rst_pch_handshake_en>(1);
 
-			/* Set hardware status page */
-			write_reg<HWS_PGA_RCSUNIT>(hwsp);
+				/* Disable RC6 state (may have been enabled by BIOS */
+				_write_posted<RC_STATE::RC6_STATE>(1);
 
-			/* Enable Execlist in GFX_MODE register */
-			write<Execlist_Enable>(Execlist_Enable::ENABLE);
+				/* Disable RC states, power gating and RP (?) */
+				_write_posted<RC_CONTROL>(0);
+				_write_posted<PG_ENABLE>(0);
+				_write_posted<RP_CONTROL>(0);
+			});
 
-			//uint32_t status = read<RCS_RING_CONTEXT_STATUS_PTR>();
+			_write_grouped ([&] () {
 
-			/* Disable PCH handshake */
-			write_reg<NDE_RSTWRN_OPT::Rst_pch_handshake_en>(0);
+				/* Disable PCH handshake */
+				_write_posted<NDE_RSTWRN_OPT::Rst_pch_handshake_en>(0);
 
-			/* SKL quirk */
-			write_reg<L3_LRA_1_GPGPU>(0x67F1427F);
+				/* SKL quirk */
+				_write_posted<L3_LRA_1_GPGPU>(0x67F1427F);
+			});
 
 			Genode::log("IGD init done status=%08x.");
 		}
 
+		/**
+		 * Prepare engine for execlist submission
+		 *
+		 * Not all SKUs have all engines, e.g., VCS1 is only present on GT3
+		 * and GT4. The registers of an absent engine read as zero, so an
+		 * engine that does not hold its hardware status page is absent.
+		 *
+		 * \param hwsp  address of the engine's hardware status page
+		 *
+		 * \return  false if the engine is not present
+		 */
+		bool setup_engine(Engine e, addr_t hwsp)
+		{
+			/* Set hardware status page, the engine must not miss it */
+			if (!_write_verified<RING_HWS_PGA>(hwsp, _ring (e)))
+				return false;
+
+			_present[e] = true;
+
+			_write_grouped ([&] () {
+
+				/* Enable Execlist in the engine's mode register */
+				_write_posted<RING_MODE>(RING_MODE::Execlist_enable_mask::bits(1) |
+				                         RING_MODE::Execlist_enable::bits(1), _ring (e));
+
+				/* Reset context status buffer read pointer */
+				context_status_read_pointer(e, Context_status_buffer::ENTRIES - 1);
+			});
+
+			if (_model)
+				_model->setup(e, hwsp);
+
+			return true;
+		}
+
+		bool engine_present(Engine e) const { return _present[e]; }
+
+		/**
+		 * Drive engines by 'model' instead of the hardware
+		 */
+		void engine_model(Engine_model &model) { _model = &model; }
+
 		void power_status()
 		{
 			Genode::log("PWR_WELL_CTL2");
@@ -272,18 +577,275 @@ class Genode::IGD : public Mmio
 			Genode::log("GFX_MODE");
 			Genode::log("   Execlist_Enable:           ", Hex (read<GFX_MODE_RCSUNIT::Execlist_Enable>()));
 			Genode::log("   Privilege_Check_Disable:   ", Hex (read<GFX_MODE_RCSUNIT::Privilege_Check_Disable>()));
-			Genode::log("HWS_PGA: ", Hex (read<HWS_PGA_RCSUNIT>()));
+			for (unsigned e = 0; e < NUM_ENGINES; e++)
+				Genode::log("HWS_PGA ", engine_name ((Engine)e), ": ",
+				            Hex (read<RING_HWS_PGA>(_ring ((Engine)e))));
+			Genode::log("Posting reads: ", _posting_reads);
 
 			//error_status();
 			//power_status();
 		}
 
-		void insert_gtt_mapping(int offset, void *pa)
+		/**
+		 * Write GGTT entry without flushing
+		 *
+		 * Entries become visible to the GPU with the next 'flush_gtt'.
+		 */
+		void write_gtt(unsigned long index, uint64_t pte)
 		{
-			_gtt[offset] = ((addr_t)pa | 1);
+			_gtt[index] = pte;
 		}
 
-		void submit_contexts (Context_descriptor element0,
+		/**
+		 * Invalidate GGTT TLBs
+		 *
+		 * The trailing posting read completes all preceding writes to the
+		 * BAR, including GGTT entries.
+		 */
+		void flush_gtt()
+		{
+			_write_grouped ([&] () {
+				_write_posted<GFX_FLSH_CNTL>(GFX_FLSH_CNTL::Enable::bits(1)); });
+		}
+
+		/**
+		 * Invalidate the PPGTT TLBs of engine 'e'
+		 *
+		 * Must be called after removing PPGTT entries and before the memory
+		 * they pointed to is reused, as the engine may still cache them.
+		 *
+		 * \return  false if the engine did not complete the invalidation
+		 */
+		bool invalidate_tlb(Engine e)
+		{
+			enum { MAX_POLLS = 100000 };
+
+			unsigned long const index = (tlb_control (e) - TLB_CONTROL::OFFSET) / 4;
+
+			_write_posted<TLB_CONTROL>(TLB_CONTROL::Invalidate::bits(1), index);
+
+			if (_model)
+				_model->invalidate_tlb(e);
+
+			/* The reads complete the write */
+			for (unsigned i = 0; i < MAX_POLLS; i++)
+				if (!TLB_CONTROL::Invalidate::get (read<TLB_CONTROL>(index)))
+					return true;
+
+			return false;
+		}
+
+		/**
+		 * Enable user and context switch interrupts of all engines
+		 */
+		void enable_interrupts()
+		{
+			typename Engine_interrupt::access_t const mask =
+				Engine_interrupt::User_interrupt::bits(1) |
+				Engine_interrupt::Context_switch::bits(1);
+
+			uint32_t enabled[GT_INTERRUPT_BANKS] = { };
+			for (unsigned e = 0; e < NUM_ENGINES; e++)
+				if (_present[e])
+					enabled[gt_interrupt_bank ((Engine)e)] |= mask << gt_interrupt_shift ((Engine)e);
+
+			_write_grouped ([&] () {
+				for (unsigned e = 0; e < NUM_ENGINES; e++)
+					if (_present[e])
+						_write_posted<RING_IMR>(~mask, _ring ((Engine)e));
+
+				for (unsigned bank = 0; bank < GT_INTERRUPT_BANKS; bank++) {
+					_write_posted<GT_INTERRUPT_IER>(enabled[bank], _gt_bank (bank));
+					_write_posted<GT_INTERRUPT_IMR>(~enabled[bank], _gt_bank (bank));
+				}
+
+				_write_posted<MASTER_INT_CTL::Master_interrupt_enable>(1);
+			});
+		}
+
+		/**
+		 * Clear pending GT interrupts
+		 *
+		 * \return  true if any interrupt was pending
+		 */
+		bool clear_interrupts()
+		{
+			bool pending = false;
+
+			/*
+			 * The read of IIR completes the disable, the trailing posting
+			 * read completes the acknowledgement before the IRQ is acked
+			 */
+			_write_grouped ([&] () {
+				_write_posted<MASTER_INT_CTL::Master_interrupt_enable>(0);
+
+				for (unsigned bank = 0; bank < GT_INTERRUPT_BANKS; bank++) {
+					uint32_t const iir = read<GT_INTERRUPT_IIR>(_gt_bank (bank));
+					if (iir) {
+						_write_posted<GT_INTERRUPT_IIR>(iir, _gt_bank (bank));
+						pending = true;
+					}
+				}
+
+				_write_posted<MASTER_INT_CTL::Master_interrupt_enable>(1);
+			});
+
+			return pending;
+		}
+
+		/**
+		 * Acknowledge context status buffer entries up to 'index'
+		 */
+		void context_status_read_pointer(Engine e, unsigned int index)
+		{
+			/* Only used by the engine to detect overflows, may be posted */
+			typedef RING_CONTEXT_STATUS_PTR Ptr;
+			_write_posted<Ptr>(Ptr::Read_pointer_mask::bits(0x7) |
+			                   Ptr::Read_pointer::bits(index), _ring (e));
+		}
+
+		/**
+		 * Error register, bits stay set after faults
+		 */
+		uint32_t errors() { return read<ERROR>(); }
+
+		/**
+		 * Direct OA reports to the buffer at GGTT address 'ga'
+		 *
+		 * \param size  power of two between 128 KiB and 16 MiB, 'ga' must
+		 *              be aligned to it
+		 */
+		void oa_buffer(addr_t ga, size_t size)
+		{
+			unsigned log2 = 0;
+			while ((128UL * 1024 << log2) < size)
+				log2++;
+
+			assert ((128UL * 1024 << log2) == size && log2 < 8);
+			assert (!(ga & (size - 1)));
+
+			/*
+			 * Clear stale status, then head, buffer and tail in the order
+			 * given by the PRM. Writing OATAILPTR last lets the unit start
+			 * with an empty buffer.
+			 */
+			_write_grouped ([&] () {
+				_write_posted<OASTATUS>(0);
+				_write_posted<OABUFFER_UDW>(0);
+				_write_posted<OAHEADPTR>(OAHEADPTR::Address::masked (ga));
+				_write_posted<OABUFFER>(OABUFFER::Address::masked (ga) |
+				                        OABUFFER::Size::bits (log2) |
+				                        OABUFFER::Memory_select::bits (OABUFFER::Memory_select::GGTT));
+				_write_posted<OATAILPTR>(OATAILPTR::Address::masked (ga));
+			});
+		}
+
+		/**
+		 * Start periodic OA reports
+		 *
+		 * \param format      report format
+		 * \param exponent    report every 2^(exponent + 1) timestamp ticks
+		 * \param context_id  if not 0, count for this context only
+		 *
+		 * \return  false if an RCS context was submitted already, the
+		 *          report timer is part of its image
+		 */
+		bool oa_enable(unsigned format, unsigned exponent, uint32_t context_id = 0)
+		{
+			if (_rcs_submitted)
+				return false;
+
+			_write_grouped ([&] () {
+				_write_posted<OACTXID>(context_id);
+				_write_posted<OACTXCONTROL>(OACTXCONTROL::Timer_period::bits (exponent) |
+				                            OACTXCONTROL::Timer_enable::bits (1) |
+				                            OACTXCONTROL::Counter_resume::bits (1));
+				_write_posted<OACONTROL>(OACONTROL::Report_format::bits (format) |
+				                         OACONTROL::Specific_context_enable::bits (context_id != 0) |
+				                         OACONTROL::Counter_enable::bits (1));
+			});
+			return true;
+		}
+
+		void oa_disable()
+		{
+			_write_grouped ([&] () {
+				_write_posted<OACONTROL>(0);
+				_write_posted<OACTXCONTROL>(0);
+			});
+		}
+
+		/**
+		 * Program register of the OA metric set, e.g., a NOA mux or flexible
+		 * EU counter configuration
+		 *
+		 * \return  false if 'offset' is no OA or NOA configuration register,
+		 *          or a flexible EU counter register after an RCS context
+		 *          was submitted
+		 */
+		bool oa_config(addr_t offset, uint32_t value)
+		{
+			if (offset >= GTT_OFFSET || (offset & 3))
+				return false;
+
+			bool const allowed = _oa_context_register (offset) ? !_rcs_submitted
+			                                                   : _oa_global_register (offset);
+			if (!allowed)
+				return false;
+
+			_write_grouped ([&] () { *_reg (offset) = value; });
+			return true;
+		}
+
+		/**
+		 * Offset of the next report the OA unit writes
+		 */
+		size_t oa_tail(addr_t ga)
+		{
+			return OATAILPTR::Address::masked (read<OATAILPTR>()) - ga;
+		}
+
+		/**
+		 * Release reports up to 'offset' to the OA unit
+		 */
+		void oa_head(addr_t ga, size_t offset)
+		{
+			/* The OA unit only compares it to its tail, may be posted */
+			_write_posted<OAHEADPTR>(OAHEADPTR::Address::masked (ga + offset));
+		}
+
+		/**
+		 * Read and clear OA status, e.g., lost reports or overflows
+		 */
+		uint32_t oa_status()
+		{
+			uint32_t const status = read<OASTATUS>();
+			if (status)
+				_write_posted<OASTATUS>(0);
+			return status;
+		}
+
+		/**
+		 * ID of the context executing on engine 'e'
+		 */
+		unsigned executing_context(Engine e)
+		{
+			return Context_status_buffer::Context_id::Id::get (read<RING_EXECLIST_STATUS_HI>(_ring (e)));
+		}
+
+		/**
+		 * Timestamp of the context executing on engine 'e'
+		 *
+		 * The register is saved to and restored from the context image, so
+		 * it counts the GPU time of the executing context.
+		 */
+		uint32_t context_timestamp(Engine e)
+		{
+			return read<RING_CTX_TIMESTAMP>(_ring (e));
+		}
+
+		void submit_contexts (Engine e,
+				      Context_descriptor element0,
 				      Context_descriptor element1 = Context_descriptor (0, 0, 0, false))
 		{
 			assert (element0.valid());
@@ -298,10 +860,23 @@ class Genode::IGD : public Mmio
 			 * 	Element 0, Low Dword
 			 */
 
-			write_reg<Execlist_submitport>(element1.high_dword());
-			write_reg<Execlist_submitport>(element1.low_dword());
-			write_reg<Execlist_submitport>(element0.high_dword());
-			write_reg<Execlist_submitport>(element0.low_dword());
+			/*
+			 * The submit port is write-only and completion is reported
+			 * through the context status buffer, so the writes are posted.
+			 * Posted writes to the same register arrive in order.
+			 */
+			_write_posted<RING_ELSP>(element1.high_dword(), _ring (e));
+			_write_posted<RING_ELSP>(element1.low_dword(),  _ring (e));
+			_write_posted<RING_ELSP>(element0.high_dword(), _ring (e));
+			_write_posted<RING_ELSP>(element0.low_dword(),  _ring (e));
+
+			if (e == RCS)
+				_rcs_submitted = true;
+
+			event_trace().record (Event_trace::ELSP_WRITE, e, element0.id(), element1.id());
+
+			if (_model)
+				_model->submit(e, element0, element1);
 		}
 };
 
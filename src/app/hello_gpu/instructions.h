@@ -14,6 +14,13 @@ namespace Genode {
 
 	class Mi_noop;
 	class Mi_batch_buffer_start;
+	class Mi_store_data_imm;
+	class Mi_batch_buffer_end;
+	class Mi_flush_dw;
+	class Pipe_control;
+	class Blt_br13;
+	class Xy_color_blt;
+	class Xy_src_copy_blt;
 }
 
 struct Genode::Op_header : Genode::Register<64>
@@ -21,7 +28,9 @@ struct Genode::Op_header : Genode::Register<64>
 	struct Command_type : Bitfield<29,  3>
 	{
 		enum {
-			MI_COMMAND = 0
+			MI_COMMAND = 0,
+			BLT_COMMAND = 2,
+			GFXPIPE = 3
 		};
 	};
 
@@ -29,10 +38,21 @@ struct Genode::Op_header : Genode::Register<64>
 	{
 		enum {
 			MI_NOOP		      = 0x00,
+			MI_BATCH_BUFFER_END   = 0x0a,
 			MI_STORE_DATA_IMM     = 0x20,
+			MI_LOAD_REGISTER_IMM  = 0x22,
+			MI_FLUSH_DW           = 0x26,
 			MI_BATCH_BUFFER_START = 0x31
 		};
 	};
+
+	struct Blt_opcode : Bitfield<22,  7>
+	{
+		enum {
+			XY_COLOR_BLT    = 0x50,
+			XY_SRC_COPY_BLT = 0x53
+		};
+	};
 };
 
 struct Genode::Op_len : Genode::Register<64>
@@ -84,8 +104,14 @@ struct Genode::Mi_batch_buffer_start
 		};
 
 	private:
-		typename Header::access_t  _header;
-		typename Address::access_t _address;
+		/*
+		 * The command consists of 3 DWords. It is padded with an MI_NOOP to
+		 * keep the ring buffer tail QWord aligned.
+		 */
+		Genode::uint32_t _header;
+		Genode::uint32_t _address_ldw;
+		Genode::uint32_t _address_udw;
+		Genode::uint32_t _noop;
 
 	public:
 		Mi_batch_buffer_start (uint64_t graphics_address, const int level, const int address_space)
@@ -95,7 +121,326 @@ struct Genode::Mi_batch_buffer_start
 				 Op_len::Dword_length::bits (1) |
 				 Header::Second_level_batch_buffer::bits (level) |
 				 Header::Address_space_indicator::bits (address_space)),
-			_address (Address::Batch_buffer_start_address::bits (graphics_address >> 2))
+			_address_ldw (Address::Batch_buffer_start_address::bits (graphics_address >> 2) & 0xffffffff),
+			_address_udw (Address::Batch_buffer_start_address::bits (graphics_address >> 2) >> 32),
+			_noop (0)
+		{
+		};
+};
+
+struct Genode::Mi_store_data_imm
+{
+		struct Header : Op_header, Op_len
+		{
+			struct Use_global_gtt : Bitfield<22,  1>
+			{
+				enum {
+					PPGTT = 0,
+					GGTT  = 1
+				};
+			};
+
+			struct Store_qword : Bitfield<21,  1> { };
+		};
+
+		struct Address : Register<64>
+		{
+			struct Dword_address	: Bitfield< 2, 62> { };
+			struct Reserved_mbz_1	: Bitfield< 0,  2> { };
+		};
+
+	private:
+		Genode::uint32_t _header;
+		Genode::uint32_t _address_ldw;
+		Genode::uint32_t _address_udw;
+		Genode::uint32_t _data;
+
+	public:
+		Mi_store_data_imm (uint64_t graphics_address, Genode::uint32_t value, const int address_space)
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::MI_COMMAND) |
+				 Op_header::Mi_command_opcode::bits (Op_header::Mi_command_opcode::MI_STORE_DATA_IMM) |
+				 Op_len::Dword_length::bits (2) |
+				 Header::Use_global_gtt::bits (address_space) |
+				 Header::Store_qword::bits (0)),
+			_address_ldw (Address::Dword_address::bits (graphics_address >> 2) & 0xffffffff),
+			_address_udw (Address::Dword_address::bits (graphics_address >> 2) >> 32),
+			_data (value)
+		{
+		};
+};
+
+struct Genode::Mi_batch_buffer_end
+{
+	private:
+		/* Padded with an MI_NOOP to keep the batch QWord aligned */
+		Genode::uint32_t _header;
+		Genode::uint32_t _noop;
+
+	public:
+		Mi_batch_buffer_end ()
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::MI_COMMAND) |
+				 Op_header::Mi_command_opcode::bits (Op_header::Mi_command_opcode::MI_BATCH_BUFFER_END)),
+			_noop (0)
+		{
+		};
+};
+
+/*
+ * Flush of the blitter, video and video enhancement engines
+ *
+ * Waits for preceding commands to complete and their writes to reach memory,
+ * optionally invalidates the TLBs, and then writes 'value' to the QWord
+ * aligned graphics address.
+ *
+ * See PRM Volume 2a: Command Reference: Instructions, MI_FLUSH_DW.
+ */
+struct Genode::Mi_flush_dw
+{
+		struct Header : Op_header, Op_len
+		{
+			struct Invalidate_tlb : Bitfield<18, 1> { };
+
+			struct Post_sync_operation : Bitfield<14, 2>
+			{
+				enum {
+					NO_WRITE        = 0,
+					WRITE_IMMEDIATE = 1
+				};
+			};
+		};
+
+		struct Address : Register<64>
+		{
+			struct Qword_address : Bitfield< 3, 61> { };
+
+			struct Destination_address_type : Bitfield< 2, 1>
+			{
+				enum {
+					PPGTT = 0,
+					GGTT  = 1
+				};
+			};
+		};
+
+	private:
+		Genode::uint32_t _header;
+		Genode::uint32_t _address_ldw;
+		Genode::uint32_t _address_udw;
+		Genode::uint32_t _data;
+
+	public:
+		Mi_flush_dw (uint64_t graphics_address, Genode::uint32_t value,
+		             const int address_space, bool invalidate_tlb = false)
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::MI_COMMAND) |
+				 Op_header::Mi_command_opcode::bits (Op_header::Mi_command_opcode::MI_FLUSH_DW) |
+				 Op_len::Dword_length::bits (2) |
+				 Header::Invalidate_tlb::bits (invalidate_tlb) |
+				 Header::Post_sync_operation::bits (Header::Post_sync_operation::WRITE_IMMEDIATE)),
+			_address_ldw ((Address::Qword_address::bits (graphics_address >> 3) |
+			               Address::Destination_address_type::bits (address_space)) & 0xffffffff),
+			_address_udw (Address::Qword_address::bits (graphics_address >> 3) >> 32),
+			_data (value)
+		{
+		};
+};
+
+/*
+ * Flush of the render engine
+ *
+ * Stalls the command streamer until preceding commands completed, flushes
+ * the render caches and then writes 'value' as QWord to the QWord aligned
+ * graphics address.
+ *
+ * See PRM Volume 2a: Command Reference: Instructions, PIPE_CONTROL.
+ */
+struct Genode::Pipe_control
+{
+		struct Header : Op_header, Op_len
+		{
+			struct Command_subtype : Bitfield<27, 2> { enum { GFXPIPE_3D = 3 }; };
+			struct Opcode          : Bitfield<24, 3> { enum { PIPE_CONTROL = 2 }; };
+		};
+
+		struct Flags : Register<32>
+		{
+			struct Depth_cache_flush         : Bitfield< 0, 1> { };
+			struct Dc_flush_enable           : Bitfield< 5, 1> { };
+			struct Render_target_cache_flush : Bitfield<12, 1> { };
+
+			struct Post_sync_operation : Bitfield<14, 2>
+			{
+				enum {
+					NO_WRITE        = 0,
+					WRITE_IMMEDIATE = 1
+				};
+			};
+
+			struct Cs_stall : Bitfield<20, 1> { };
+
+			struct Destination_address_type : Bitfield<24, 1>
+			{
+				enum {
+					PPGTT = 0,
+					GGTT  = 1
+				};
+			};
+		};
+
+		struct Address : Register<64>
+		{
+			struct Qword_address : Bitfield< 3, 61> { };
+		};
+
+	private:
+		Genode::uint32_t _header;
+		Genode::uint32_t _flags;
+		Genode::uint32_t _address_ldw;
+		Genode::uint32_t _address_udw;
+		Genode::uint32_t _data_ldw;
+		Genode::uint32_t _data_udw;
+
+	public:
+		Pipe_control (uint64_t graphics_address, Genode::uint32_t value, const int address_space)
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::GFXPIPE) |
+				 Header::Command_subtype::bits (Header::Command_subtype::GFXPIPE_3D) |
+				 Header::Opcode::bits (Header::Opcode::PIPE_CONTROL) |
+				 Op_len::Dword_length::bits (4)),
+			_flags (Flags::Depth_cache_flush::bits (1) |
+				Flags::Dc_flush_enable::bits (1) |
+				Flags::Render_target_cache_flush::bits (1) |
+				Flags::Post_sync_operation::bits (Flags::Post_sync_operation::WRITE_IMMEDIATE) |
+				Flags::Cs_stall::bits (1) |
+				Flags::Destination_address_type::bits (address_space)),
+			_address_ldw (Address::Qword_address::bits (graphics_address >> 3) & 0xffffffff),
+			_address_udw (Address::Qword_address::bits (graphics_address >> 3) >> 32),
+			_data_ldw (value),
+			_data_udw (0)
+		{
+		};
+};
+
+/*
+ * Blitter commands
+ *
+ * See PRM Volume 2a: Command Reference: Instructions, XY_COLOR_BLT and
+ * XY_SRC_COPY_BLT. All blits use linear 32 bit pixels. Coordinates are in
+ * pixels, the bottom-right corner is exclusive.
+ */
+
+struct Genode::Blt_br13 : Genode::Register<32>
+{
+	struct Pitch        : Bitfield< 0, 16> { };
+	struct Raster_op    : Bitfield<16,  8>
+	{
+		enum {
+			SRCCOPY = 0xcc,
+			PATCOPY = 0xf0
+		};
+	};
+	struct Color_depth  : Bitfield<24,  2>
+	{
+		enum { BPP_32 = 3 };
+	};
+};
+
+struct Genode::Xy_color_blt
+{
+		struct Header : Op_header, Op_len
+		{
+			struct Write_rgb   : Bitfield<20,  1> { };
+			struct Write_alpha : Bitfield<21,  1> { };
+		};
+
+		struct Coordinate : Register<32>
+		{
+			struct X : Bitfield< 0, 16> { };
+			struct Y : Bitfield<16, 16> { };
+		};
+
+	private:
+		/*
+		 * The command consists of 7 DWords. It is padded with an MI_NOOP to
+		 * keep the batch QWord aligned.
+		 */
+		Genode::uint32_t _header;
+		Genode::uint32_t _br13;
+		Genode::uint32_t _top_left;
+		Genode::uint32_t _bottom_right;
+		Genode::uint32_t _address_ldw;
+		Genode::uint32_t _address_udw;
+		Genode::uint32_t _color;
+		Genode::uint32_t _noop;
+
+	public:
+		Xy_color_blt (uint64_t graphics_address, Genode::uint16_t pitch,
+		              Genode::uint16_t width, Genode::uint16_t height,
+		              Genode::uint32_t color)
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::BLT_COMMAND) |
+				 Op_header::Blt_opcode::bits (Op_header::Blt_opcode::XY_COLOR_BLT) |
+				 Header::Write_alpha::bits (1) |
+				 Header::Write_rgb::bits (1) |
+				 Op_len::Dword_length::bits (5)),
+			_br13 (Blt_br13::Pitch::bits (pitch) |
+			       Blt_br13::Raster_op::bits (Blt_br13::Raster_op::PATCOPY) |
+			       Blt_br13::Color_depth::bits (Blt_br13::Color_depth::BPP_32)),
+			_top_left (0),
+			_bottom_right (Coordinate::X::bits (width) | Coordinate::Y::bits (height)),
+			_address_ldw (graphics_address & 0xffffffff),
+			_address_udw (graphics_address >> 32),
+			_color (color),
+			_noop (0)
+		{
+		};
+};
+
+struct Genode::Xy_src_copy_blt
+{
+		struct Header : Op_header, Op_len
+		{
+			struct Write_rgb   : Bitfield<20,  1> { };
+			struct Write_alpha : Bitfield<21,  1> { };
+		};
+
+		typedef Xy_color_blt::Coordinate Coordinate;
+
+	private:
+		Genode::uint32_t _header;
+		Genode::uint32_t _br13;
+		Genode::uint32_t _dst_top_left;
+		Genode::uint32_t _dst_bottom_right;
+		Genode::uint32_t _dst_address_ldw;
+		Genode::uint32_t _dst_address_udw;
+		Genode::uint32_t _src_top_left;
+		Genode::uint32_t _src_pitch;
+		Genode::uint32_t _src_address_ldw;
+		Genode::uint32_t _src_address_udw;
+
+	public:
+		Xy_src_copy_blt (uint64_t dst_address, uint64_t src_address,
+		                 Genode::uint16_t pitch, Genode::uint16_t width,
+		                 Genode::uint16_t height)
+		:
+			_header (Op_header::Command_type::bits (Op_header::Command_type::BLT_COMMAND) |
+				 Op_header::Blt_opcode::bits (Op_header::Blt_opcode::XY_SRC_COPY_BLT) |
+				 Header::Write_alpha::bits (1) |
+				 Header::Write_rgb::bits (1) |
+				 Op_len::Dword_length::bits (8)),
+			_br13 (Blt_br13::Pitch::bits (pitch) |
+			       Blt_br13::Raster_op::bits (Blt_br13::Raster_op::SRCCOPY) |
+			       Blt_br13::Color_depth::bits (Blt_br13::Color_depth::BPP_32)),
+			_dst_top_left (0),
+			_dst_bottom_right (Coordinate::X::bits (width) | Coordinate::Y::bits (height)),
+			_dst_address_ldw (dst_address & 0xffffffff),
+			_dst_address_udw (dst_address >> 32),
+			_src_top_left (0),
+			_src_pitch (Blt_br13::Pitch::bits (pitch)),
+			_src_address_ldw (src_address & 0xffffffff),
+			_src_address_udw (src_address >> 32)
 		{
 		};
 };
@@ -14,17 +14,30 @@
 #include <util/retry.h>
 #include <timer_session/connection.h>
 #include <spec/x86_64/translation_table.h>
+#include <os/config.h>
+#include <os/reporter.h>
+#include <base/heap.h>
 
 #include <igd.h>
 #include <gpu_allocator.h>
 #include <context.h>
 #include <submission.h>
+#include <quota.h>
+#include <scheduler.h>
+#include <context_status.h>
+#include <completion.h>
+#include <ggtt.h>
+#include <blitter.h>
+#include <batch_pool.h>
+#include <gpu_root.h>
+#include <hw_backend.h>
+#include <sim_backend.h>
+#include <event_trace.h>
+#include <oa.h>
 
 using namespace Genode;
 
 Genode::size_t Component::stack_size() { return 64*1024; }
-static Timer::Connection timer;
-static Platform::Connection pci;
 
 static void print_device_info (Platform::Device_capability device_cap)
 {
@@ -58,7 +71,7 @@ static void print_device_info (Platform::Device_capability device_cap)
 	}
 }
 
-static Platform::Device_capability find_gpu_device (Genode::Env &env)
+static Platform::Device_capability find_gpu_device (Platform::Connection &pci)
 {
 	unsigned char bus = 0, dev = 0, fun = 0;
 
@@ -83,22 +96,373 @@ static Platform::Device_capability find_gpu_device (Genode::Env &env)
 	return dev_cap;
 }
 
-void config_write(Genode::Env &env, Platform::Device_client *device,
+void config_write(Quota_manager &quota, Platform::Device_client *device,
                   uint8_t op, uint16_t cmd,
                   Platform::Device::Access_size width)
 {
-	Genode::size_t donate = 4096;
-	Genode::retry<Platform::Device::Quota_exceeded>(
-		[&] () { device->config_write(op, cmd, width); },
-		[&] () {
-			char quota[32];
-			Genode::snprintf(quota, sizeof(quota), "ram_quota=%ld",
-			                 donate);
-			env.parent().upgrade(pci.cap(), quota);
-			donate *= 2;
-		});
+	/* Config writes allocate no DMA memory */
+	quota.request<Platform::Device::Quota_exceeded>(
+		[&] () { device->config_write(op, cmd, width); });
 }
 
+/**
+ * DMA quota donated to the platform driver up front
+ */
+static size_t dma_working_set(Xml_node config)
+{
+	Number_of_bytes working_set = 4*1024*1024;
+
+	try {
+		working_set = config.sub_node("dma").attribute_value("working_set", working_set);
+	} catch (Xml_node::Nonexistent_sub_node) { }
+
+	return working_set;
+}
+
+/**
+ * Backend of the GPU service, either "hw" or "sim"
+ */
+static String<8> backend_type(Xml_node config)
+{
+	String<8> type("hw");
+
+	try {
+		type = config.sub_node("backend").attribute_value("type", type);
+	} catch (Xml_node::Nonexistent_sub_node) { }
+
+	return type;
+}
+
+/**
+ * Expire timeslices of all engine schedulers
+ *
+ * The timeslice is set by the 'timeslice_us' attribute of the config's
+ * 'scheduler' node. The timer is armed by the schedulers only while a
+ * context waits behind element 0 of their port.
+ */
+struct Timeslice : Execlist_scheduler::Timeslice_timer
+{
+	Timer::Connection           timer;
+	Execlist_scheduler        **scheduler;
+	Signal_handler<Timeslice>   handler;
+	unsigned long               timeslice_us = 1000;
+	bool                        armed        = false;
+
+	void handle()
+	{
+		armed = false;
+
+		for (unsigned i = 0; i < NUM_ENGINES; i++)
+			if (scheduler[i])
+				scheduler[i]->timeslice();
+	}
+
+	void arm() override
+	{
+		if (armed)
+			return;
+
+		timer.trigger_once (timeslice_us);
+		armed = true;
+	}
+
+	Timeslice(Env &env, Execlist_scheduler **scheduler, Xml_node config)
+	:
+		timer (env), scheduler (scheduler),
+		handler (env.ep(), *this, &Timeslice::handle)
+	{
+		try {
+			timeslice_us = config.sub_node("scheduler").attribute_value("timeslice_us", timeslice_us);
+		} catch (Xml_node::Nonexistent_sub_node) { }
+
+		timer.sigh (handler);
+
+		for (unsigned i = 0; i < NUM_ENGINES; i++)
+			if (scheduler[i])
+				scheduler[i]->timeslice_timer (*this);
+	}
+};
+
+/**
+ * Periodic report of the GPU time of all GPU sessions
+ *
+ * Enabled by the config's 'gpu_time' node:
+ *
+ * <gpu_time period_ms="1000" timestamp_khz="12000"/>
+ *
+ * The context timestamp counts at 12 MHz on Gen9.
+ */
+struct Gpu_time_report
+{
+	Gpu::Root                       &root;
+	Timer::Connection                timer;
+	Reporter                         reporter { "gpu_time", "gpu_time", 64*1024 };
+	Signal_handler<Gpu_time_report>  handler;
+	unsigned long                    timestamp_khz;
+
+	void handle()
+	{
+		Reporter::Xml_generator xml(reporter, [&] () { root.gpu_time(xml, timestamp_khz); });
+	}
+
+	Gpu_time_report(Env &env, Gpu::Root &root, Xml_node config)
+	:
+		root (root), timer (env),
+		handler (env.ep(), *this, &Gpu_time_report::handle),
+		timestamp_khz (config.attribute_value("timestamp_khz", 12000UL))
+	{
+		reporter.enabled(true);
+
+		timer.sigh (handler);
+		timer.trigger_periodic (config.attribute_value("period_ms", 1000UL) * 1000);
+	}
+};
+
+/**
+ * Periodic sampling of the OA performance counters
+ *
+ * Enabled by the config's 'oa' node:
+ *
+ * <oa buffer_size="131072" period_exponent="16" period_ms="100"
+ *     context="0x0" context_mask="0xfffff000" specific="no" dump="no">
+ *   <register offset="0x9888" value="0x..."/>
+ * </oa>
+ *
+ * The 'register' nodes program the metric set before counting starts. Only
+ * OA trigger (0x2710-0x27ff), NOA (0x9800-0x9fff) and flexible EU counter
+ * registers are accepted. As the latter and the report timer are part of
+ * the render context image, the sampler is started before the first render
+ * context runs. If 'context' is set, only deltas of this context
+ * are aggregated. The ID of a session's context is reported as 'oa_context'
+ * in the "gpu_time" report. With 'specific' set, the OA unit itself counts
+ * for this context only. The aggregate is reported as "gpu_oa". With 'dump'
+ * set, the raw reports are logged, e.g., to record fixtures for the
+ * oa_report test. The buffer size is a power of two from 128 KiB to 16 MiB.
+ */
+struct Oa_sampler
+{
+	IGD                        &igd;
+	Timer::Connection           timer;
+	Reporter                    reporter { "gpu_oa", "gpu_oa", 16*1024 };
+	Signal_handler<Oa_sampler>  handler;
+
+	size_t const  size;
+	bool   const  dump;
+	void         *buffer = nullptr;
+	addr_t        ga     = 0;
+	size_t        head   = 0;
+	unsigned long lost   = 0;
+
+	Oa_buffer reports;
+
+	static size_t _buffer_size(Xml_node config)
+	{
+		size_t const size = config.attribute_value("buffer_size", 128*1024UL);
+		if (size < 128*1024 || size > 16*1024*1024 || (size & (size - 1))) {
+			error ("OA buffer_size ", size, " is no power of two from 128K to 16M");
+			throw -1;
+		}
+		return size;
+	}
+
+	static void *_alloc(GPU_allocator &gpu_allocator, size_t size)
+	{
+		void *buffer;
+		if (!gpu_allocator.alloc (size, &buffer))
+			throw -1;
+
+		/* Slots not written yet are all zero */
+		memset (buffer, 0, size);
+		return buffer;
+	}
+
+	/*
+	 * Log reports from 'from' to 'to' as hex dwords, eight per line
+	 */
+	void _dump(size_t from, size_t to)
+	{
+		for (; from != to; from = (from + Oa_report::SIZE) % size) {
+			uint32_t const *dw = (uint32_t const *)((uint8_t *)buffer + from);
+
+			for (unsigned i = 0; i < Oa_report::SIZE / 4; i += 8)
+				log ("oa ", Hex(dw[i]),     " ", Hex(dw[i + 1]), " ",
+				            Hex(dw[i + 2]), " ", Hex(dw[i + 3]), " ",
+				            Hex(dw[i + 4]), " ", Hex(dw[i + 5]), " ",
+				            Hex(dw[i + 6]), " ", Hex(dw[i + 7]));
+		}
+	}
+
+	void handle()
+	{
+		/* Deltas must not span lost reports */
+		if (igd.oa_status()) {
+			lost++;
+			reports.restart();
+		}
+
+		size_t const tail = igd.oa_tail (ga);
+		if (dump)
+			_dump (head, tail);
+
+		head = reports.consume (head, tail);
+		igd.oa_head (ga, head);
+
+		Oa_counters const &c = reports.counters();
+
+		Reporter::Xml_generator xml(reporter, [&] () {
+			xml.attribute ("reports",   reports.reports());
+			xml.attribute ("filtered",  reports.filtered());
+			xml.attribute ("lost",      lost);
+			xml.attribute ("timestamp", (unsigned long)c.timestamp());
+			xml.attribute ("gpu_ticks", (unsigned long)c.gpu_ticks());
+
+			auto counter = [&] (char const *type, unsigned i, uint64_t value) {
+				xml.node (type, [&] () {
+					xml.attribute ("index", (unsigned long)i);
+					xml.attribute ("value", (unsigned long)value);
+				});
+			};
+
+			for (unsigned i = 0; i < Oa_report::A_COUNTERS; i++) counter ("a", i, c.a(i));
+			for (unsigned i = 0; i < Oa_report::B_COUNTERS; i++) counter ("b", i, c.b(i));
+			for (unsigned i = 0; i < Oa_report::C_COUNTERS; i++) counter ("c", i, c.c(i));
+		});
+	}
+
+	Oa_sampler(Env &env, IGD &igd, GPU_allocator &gpu_allocator, Ggtt &ggtt, Xml_node config)
+	:
+		igd (igd), timer (env),
+		handler (env.ep(), *this, &Oa_sampler::handle),
+		size (_buffer_size (config)),
+		dump (config.attribute_value("dump", false)),
+		buffer (_alloc (gpu_allocator, size)),
+		reports (buffer, size)
+	{
+		/* The OA unit requires the buffer to be aligned to its size */
+		if (!ggtt.alloc (size, ga, log2 (size)))
+			throw -1;
+		ggtt.insert (ga, (addr_t)gpu_allocator.phys_addr (buffer), size);
+
+		uint32_t const context = config.attribute_value("context", 0UL);
+		if (context)
+			reports.filter (context, config.attribute_value("context_mask", ~0UL));
+
+		config.for_each_sub_node ("register", [&] (Xml_node reg) {
+			addr_t const offset = reg.attribute_value("offset", 0UL);
+			if (!igd.oa_config (offset, reg.attribute_value("value", 0UL))) {
+				error ("OA register ", Hex(offset), " is no metric set register");
+				throw -1;
+			}
+		});
+
+		igd.oa_buffer (ga, size);
+		if (!igd.oa_enable (Oa_report::FORMAT, config.attribute_value("period_exponent", 16U),
+		                    config.attribute_value("specific", false) ? context : 0)) {
+			error ("OA unit must be enabled before render contexts run");
+			throw -1;
+		}
+
+		reporter.enabled(true);
+
+		timer.sigh (handler);
+		timer.trigger_periodic (config.attribute_value("period_ms", 100UL) * 1000);
+	}
+};
+
+/**
+ * Event trace configured by the config's 'trace' node
+ *
+ * <trace enabled="yes" format="chrome" period_ms="1000"/>
+ *
+ * The trace is reported as "gpu_trace" periodically once the driver is
+ * started, either as XML (the default) or in the Chrome trace event format.
+ */
+struct Trace_report
+{
+	enum { BUFFER_SIZE = Event_trace::CAPACITY * 256 };
+
+	bool     chrome = false;
+	Reporter reporter { "gpu_trace", "gpu_trace", BUFFER_SIZE };
+
+	Timer::Connection            timer;
+	Signal_handler<Trace_report> handler;
+	unsigned long                period_ms  = 1000;
+	Trace::Timestamp             tsc_per_us = 0;
+
+	/* JSON is generated into a buffer of its own, only used by this format */
+	char *json = nullptr;
+
+	Trace_report(Env &env, Allocator &alloc, Xml_node config)
+	:
+		timer (env), handler (env.ep(), *this, &Trace_report::report)
+	{
+		try {
+			Xml_node node = config.sub_node("trace");
+
+			event_trace().enabled(node.attribute_value("enabled", false));
+			chrome    = node.attribute_value("format", String<8>("xml")) == "chrome";
+			period_ms = node.attribute_value("period_ms", period_ms);
+		} catch (Xml_node::Nonexistent_sub_node) { }
+
+		reporter.enabled(event_trace().enabled());
+
+		if (event_trace().enabled() && chrome)
+			json = (char *)alloc.alloc(BUFFER_SIZE);
+	}
+
+	/**
+	 * Start periodic reports
+	 *
+	 * \param tsc_per_us  frequency of the trace timestamps
+	 */
+	void start(Trace::Timestamp tsc_per_us)
+	{
+		this->tsc_per_us = tsc_per_us;
+
+		if (!event_trace().enabled())
+			return;
+
+		timer.sigh (handler);
+		timer.trigger_periodic (period_ms * 1000);
+	}
+
+	void report()
+	{
+		if (!event_trace().enabled())
+			return;
+
+		if (json) {
+			reporter.report(json, event_trace().chrome_json(json, BUFFER_SIZE, tsc_per_us));
+			return;
+		}
+
+		Reporter::Xml_generator xml(reporter, [&] () { event_trace().xml(xml); });
+	}
+};
+
+struct Completion_handler : Completion::Handler
+{
+	IGD             &igd;
+	Gpu::Hw_backend *backend = nullptr;
+
+	Completion_handler(IGD &igd) : igd (igd) { }
+
+	/* Events are recorded by the scheduler's trace point */
+	void context_event(Engine, Context_status_buffer::Event const &e) override
+	{
+		if (backend && e.complete())
+			backend->context_complete (e.context_id());
+	}
+
+	void idle() override
+	{
+		//submission.info();
+		igd.status();
+
+		log ("Done");
+	}
+};
+
 void Component::construct(Genode::Env &env)
 {
 	enum {
@@ -107,12 +471,31 @@ void Component::construct(Genode::Env &env)
 
 	Io_mem_session_capability io_mem;
 
+	log ("Hello GPU!");
+
+	static Heap heap (env.ram(), env.rm());
+
+	// Enable event trace before touching the GPU
+	static Trace_report trace (env, heap, Genode::config()->xml_node());
+
+	// Serve GPU sessions without touching any hardware
+	if (backend_type (Genode::config()->xml_node()) == "sim")
+	{
+		static Gpu::Sim_backend backend (env, heap);
+		static Gpu::Root root (env, heap, backend);
+
+		env.parent().announce (env.ep().manage (root));
+		log ("GPU service using simulated backend");
+		return;
+	}
+
+	static Timer::Connection timer (env);
+
 	// Open connection to PCI service
+	static Platform::Connection pci (env);
 	static Platform::Device_capability gpu_cap;
 
-	log ("Hello GPU!");
-
-	gpu_cap = find_gpu_device (env);
+	gpu_cap = find_gpu_device (pci);
 	if (!gpu_cap.valid())
 		throw -1;
 
@@ -120,10 +503,12 @@ void Component::construct(Genode::Env &env)
 	print_device_info (gpu_cap);
 	Platform::Device_client device(gpu_cap);
 
+	static Quota_manager quota (env, pci.cap(), dma_working_set (Genode::config()->xml_node()));
+
 	// Enable bus master
 	uint16_t cmd = device.config_read(PCI_CMD_REG, Platform::Device::ACCESS_16BIT);
 	cmd |= 0x4;
-	config_write(env, &device, PCI_CMD_REG, cmd, Platform::Device::ACCESS_16BIT);
+	config_write(quota, &device, PCI_CMD_REG, cmd, Platform::Device::ACCESS_16BIT);
 
 	// Map BAR0
 	Platform::Device::Resource const bar0 = device.resource(0);
@@ -146,22 +531,82 @@ void Component::construct(Genode::Env &env)
 	uint8_t *aperture_addr __attribute__((unused)) = env.rm().attach(bar2_ds, bar2.size());
 
 	// GPU DMA allocator
-	GPU_allocator<100> gpu_allocator (env, pci);
+	static GPU_allocator gpu_allocator (env, pci, quota, GPU_allocator::POOL);
+
+	uint8_t *igd_addr = env.rm().attach(bar0_ds, bar0.size());
+	static IGD igd (env, (addr_t) igd_addr);
+
+	// Global GTT address space, one entry per page in the upper half of BAR0
+	static Ggtt ggtt (igd, heap, (bar0.size() - IGD::GTT_OFFSET) / sizeof(uint64_t) * Ggtt::PAGE_SIZE);
+
+	/*
+	 * Objects used by the completion handler outlive this function, as
+	 * completion may be signaled by an interrupt after we return.
+	 */
+	static Completion_handler handler (igd);
+	static Completion completion (env, igd, handler, device.irq (0),
+	                              timer, Genode::config()->xml_node());
 
-	// Allocate hardware status page
-	uint32_t *hwsp;
-	if (!gpu_allocator.alloc (5 * 4096, (void **)&hwsp))
+	// Report the trace periodically from now on
+	trace.start (completion.tsc_per_us());
+
+	// Hardware status page, context status buffer and scheduler per engine
+	static Execlist_scheduler *scheduler[NUM_ENGINES];
+	for (unsigned i = 0; i < NUM_ENGINES; i++)
 	{
-		log ("Allocating hardware status page failed");
-		throw -1;
+		Engine const e = (Engine)i;
+
+		uint32_t *hwsp;
+		if (!gpu_allocator.alloc (4096, (void **)&hwsp))
+		{
+			log ("Allocating hardware status page failed");
+			throw -1;
+		}
+		memset(hwsp, 0, 4096);
+		if (!igd.setup_engine (e, (addr_t)gpu_allocator.phys_addr (hwsp)))
+		{
+			log (engine_name (e), " not present");
+			gpu_allocator.free (hwsp, 4096);
+
+			/* Render and blitter engine are present on all SKUs */
+			if (e == RCS || e == BCS)
+				throw -1;
+			continue;
+		}
+
+		Context_status_buffer *csb = new (heap) Context_status_buffer (hwsp);
+		scheduler[e] = new (heap) Execlist_scheduler (igd, e, *csb);
+		completion.add (*scheduler[e]);
 	}
-	memset(hwsp, 0, 5 * 4096);
-	void *hwsp_pa = gpu_allocator.phys_addr (hwsp);
 
-	uint8_t *igd_addr = env.rm().attach(bar0_ds, bar0.size());
-	IGD igd (env, (addr_t) igd_addr, (addr_t)hwsp_pa);
+	static Timeslice timeslice (env, scheduler, Genode::config()->xml_node());
+
+	// OA context registers are saved in render context images, so start before any runs
+	try {
+		static Oa_sampler oa (env, igd, gpu_allocator, ggtt, Genode::config()->xml_node().sub_node("oa"));
+	} catch (Xml_node::Nonexistent_sub_node) { }
+
+	// Context images, rings and PPGTTs are recycled after teardown
+	static Context_pool context_pool (gpu_allocator, heap);
 
-	Submission submission (&gpu_allocator, igd, 100);
+	// Two render contexts and one context on every other present engine
+	static Submission submission (&gpu_allocator, context_pool, igd, RCS, 100, 1);
+	static Submission second (&gpu_allocator, context_pool, igd, RCS, 100, 2);
+
+	static Submission *other[NUM_ENGINES - 1];
+	for (unsigned i = 0; i < NUM_ENGINES - 1; i++)
+		if (scheduler[i + 1])
+			other[i] = new (heap) Submission (&gpu_allocator, context_pool, igd, (Engine)(i + 1), 100, i + 3);
+
+	// Batch buffers stay mapped in every context and are recycled once completed
+	enum { BATCH_GA = 0xba7c4000, BATCHES = 4 };
+	static Batch_pool submission_batches (gpu_allocator, heap, submission, BATCH_GA, BATCHES);
+	static Batch_pool second_batches (gpu_allocator, heap, second, BATCH_GA, BATCHES);
+
+	static Batch_pool *other_batches[NUM_ENGINES - 1];
+	for (unsigned i = 0; i < NUM_ENGINES - 1; i++)
+		if (other[i])
+			other_batches[i] = new (heap) Batch_pool (gpu_allocator, heap, *other[i], BATCH_GA, BATCHES);
 
 	const Page_flags page_flags = Page_flags
 		{ .writeable  = true,
@@ -171,21 +616,6 @@ void Component::construct(Genode::Env &env)
 		  .device     = false,
 		  .cacheable  = UNCACHED };
 
-	// Allocate one page of DMA memory as batch buffer
-	uint32_t *batch_buffer;
-	if (!gpu_allocator.alloc (4096, (void **)&batch_buffer))
-	{
-		log ("Allocating batch buffer failed");
-		throw -1;
-	}
-
-	void *batch_pa = gpu_allocator.phys_addr (batch_buffer);
-	memset(batch_buffer, 0, 4096);
-
-	addr_t batch_ga = 0xba7c4000;
-	submission.insert_translation (batch_ga, (addr_t)batch_pa, 4096, page_flags);
-
-
 	// Allocate one page of DMA memory as scratch page for later tests
 	uint8_t *scratch_addr;
 	if (!gpu_allocator.alloc (4096, (void **)&scratch_addr))
@@ -202,20 +632,67 @@ void Component::construct(Genode::Env &env)
 		throw -1;
 	}
 
+	// Clear scratch page on the blitter engine instead of the CPU
+	static Blitter blitter (gpu_allocator, context_pool, igd, *scheduler[BCS], NUM_ENGINES + 2);
+
+	uint32_t scratch_seqno;
+	if (!blitter.fill ((addr_t)scratch_pa, 4096, 0, scratch_seqno))
+	{
+		log ("Blitter busy");
+		throw -1;
+	}
+
+	// The render context must not see the page before it is cleared
+	enum { BLIT_TIMEOUT_US = 100*1000 };
+	if (!blitter.wait (scratch_seqno, BLIT_TIMEOUT_US * completion.tsc_per_us()))
+	{
+		log ("Clearing scratch page timed out");
+		throw -1;
+	}
+
 	submission.insert_translation (0xdeadbeef000, (addr_t)scratch_pa, 4096, page_flags);
 
-	/* Fill batch buffer */
-	// ...
-	batch_buffer[0] = 0;
+	auto submit_batch = [&] (Submission &s, Batch_pool &pool) {
+
+		Batch *batch = pool.alloc();
+		if (!batch)
+		{
+			log ("No batch available");
+			throw -1;
+		}
+		batch->emit (Mi_noop());
+
+		if (!pool.submit (*batch))
+		{
+			log ("Submission ring full");
+			throw -1;
+		}
+		scheduler[s.engine()]->submit (s);
+	};
+
+	/* Both render contexts end up in the execlist port */
+	submit_batch (submission, submission_batches);
+	submit_batch (second, second_batches);
+
+	/* Other engines run concurrently */
+	for (unsigned i = 0; i < NUM_ENGINES - 1; i++)
+		if (other[i])
+			submit_batch (*other[i], *other_batches[i]);
+
+	quota.print_stats ();
+
+	// Serve GPU sessions, each with a render context of its own
+	static Gpu::Hw_backend backend (pci, quota, gpu_allocator, context_pool, igd,
+	                                *scheduler[RCS], heap, NUM_ENGINES + 3);
+	handler.backend = &backend;
 
-	/* Inset batch buffer as new job */
-	submission.insert (batch_ga);
+	static Gpu::Root root (env, heap, backend);
+	env.parent().announce (env.ep().manage (root));
 
-	igd.submit_contexts (submission.context_descriptor());
-	timer.usleep (1000000);
-	//submission.info();
-	igd.status();
+	try {
+		static Gpu_time_report gpu_time (env, root, Genode::config()->xml_node().sub_node("gpu_time"));
+	} catch (Xml_node::Nonexistent_sub_node) { }
 
-	pci.release_device (gpu_cap);
-	log ("Done");
+	/* Completion handler finishes once all contexts completed */
+	completion.wait ();
 }
@@ -0,0 +1,270 @@
+/*
+ * \brief  Decoding and aggregation of OA performance counter reports
+ * \author Alexander Senier
+ * \date   2017-02-03
+ */
+
+/*
+ * The observation architecture (OA) unit periodically writes snapshots of
+ * its counters as reports into a ring buffer in graphics memory. Counters
+ * only increase and wrap, so the values of interest are the deltas between
+ * consecutive reports. The delta between two reports is attributed to the
+ * context of the earlier one, which was executing while the counters
+ * advanced. Context switches trigger reports of their own, so deltas do
+ * not span two contexts.
+ *
+ * Nothing here touches the device, so recorded report buffers can be
+ * decoded and aggregated offline.
+ */
+
+#ifndef _OA_H_
+#define _OA_H_
+
+#include <util/register.h>
+#include <util/string.h>
+
+namespace Genode {
+
+	class Oa_report;
+	class Oa_counters;
+	class Oa_buffer;
+}
+
+/**
+ * Report of the A32u40_A4u32_B8_C8 format
+ *
+ * dword  0       report ID and reason
+ * dword  1       timestamp
+ * dword  2       context ID
+ * dword  3       GPU ticks
+ * dword  4..35   A0..A31, low 32 bits
+ * dword 36..39   A32..A35
+ * byte 160..191  A0..A31, high 8 bits
+ * dword 48..55   B0..B7
+ * dword 56..63   C0..C7
+ */
+class Genode::Oa_report
+{
+	public:
+
+		enum {
+			FORMAT = 5,
+			SIZE   = 256,
+
+			A40_COUNTERS = 32,
+			A_COUNTERS   = 36,
+			B_COUNTERS   = 8,
+			C_COUNTERS   = 8,
+		};
+
+		struct Header : Register<32>
+		{
+			struct Reason : Bitfield<19, 6>
+			{
+				enum {
+					TIMER              = 1 << 0,
+					INTERNAL_TRIGGER_1 = 1 << 1,
+					INTERNAL_TRIGGER_2 = 1 << 2,
+					CONTEXT_SWITCH     = 1 << 3,
+					GO_TRANSITION      = 1 << 4,
+					CLOCK_RATIO_CHANGE = 1 << 5,
+				};
+			};
+		};
+
+	private:
+
+		uint32_t const *_dw;
+
+		uint8_t const *_bytes() const { return (uint8_t const *)_dw; }
+
+	public:
+
+		Oa_report(void const *report) : _dw ((uint32_t const *)report) { }
+
+		/**
+		 * Reports are never all zero, zeroed slots were not written yet
+		 */
+		bool valid() const { return _dw[0] || _dw[1]; }
+
+		unsigned reason()     const { return Header::Reason::get (_dw[0]); }
+		uint32_t timestamp()  const { return _dw[1]; }
+		uint32_t context_id() const { return _dw[2]; }
+		uint32_t gpu_ticks()  const { return _dw[3]; }
+
+		/**
+		 * A counter, A0..A31 are 40 bit wide
+		 */
+		uint64_t a(unsigned i) const
+		{
+			if (i < A40_COUNTERS)
+				return _dw[4 + i] | (uint64_t)_bytes()[160 + i] << 32;
+
+			return i < A_COUNTERS ? _dw[4 + i] : 0;
+		}
+
+		uint32_t b(unsigned i) const { return i < B_COUNTERS ? _dw[48 + i] : 0; }
+		uint32_t c(unsigned i) const { return i < C_COUNTERS ? _dw[56 + i] : 0; }
+};
+
+/**
+ * Sums of counter deltas
+ */
+class Genode::Oa_counters
+{
+	private:
+
+		uint64_t _a[Oa_report::A_COUNTERS];
+		uint64_t _b[Oa_report::B_COUNTERS];
+		uint64_t _c[Oa_report::C_COUNTERS];
+
+		uint64_t      _timestamp = 0;
+		uint64_t      _gpu_ticks = 0;
+		unsigned long _deltas    = 0;
+
+		static uint64_t _delta(uint64_t prev, uint64_t cur, unsigned width) {
+			return (cur - prev) & ((1ULL << width) - 1); }
+
+	public:
+
+		Oa_counters() { reset(); }
+
+		void reset()
+		{
+			memset (_a, 0, sizeof(_a));
+			memset (_b, 0, sizeof(_b));
+			memset (_c, 0, sizeof(_c));
+			_timestamp = _gpu_ticks = _deltas = 0;
+		}
+
+		/**
+		 * Add deltas from report 'prev' to report 'cur'
+		 */
+		void add(Oa_report const &prev, Oa_report const &cur)
+		{
+			for (unsigned i = 0; i < Oa_report::A_COUNTERS; i++)
+				_a[i] += _delta (prev.a(i), cur.a(i), i < Oa_report::A40_COUNTERS ? 40 : 32);
+
+			for (unsigned i = 0; i < Oa_report::B_COUNTERS; i++)
+				_b[i] += _delta (prev.b(i), cur.b(i), 32);
+
+			for (unsigned i = 0; i < Oa_report::C_COUNTERS; i++)
+				_c[i] += _delta (prev.c(i), cur.c(i), 32);
+
+			_timestamp += _delta (prev.timestamp(), cur.timestamp(), 32);
+			_gpu_ticks += _delta (prev.gpu_ticks(), cur.gpu_ticks(), 32);
+			_deltas++;
+		}
+
+		uint64_t a(unsigned i) const { return i < Oa_report::A_COUNTERS ? _a[i] : 0; }
+		uint64_t b(unsigned i) const { return i < Oa_report::B_COUNTERS ? _b[i] : 0; }
+		uint64_t c(unsigned i) const { return i < Oa_report::C_COUNTERS ? _c[i] : 0; }
+
+		uint64_t      timestamp() const { return _timestamp; }
+		uint64_t      gpu_ticks() const { return _gpu_ticks; }
+		unsigned long deltas()    const { return _deltas; }
+};
+
+/**
+ * Consumer of the OA report ring
+ */
+class Genode::Oa_buffer
+{
+	private:
+
+		uint8_t      *_base;
+		size_t  const _size;
+
+		/* Copy of the last report, its slot may be overwritten meanwhile */
+		uint8_t _last[Oa_report::SIZE];
+		bool    _have_last = false;
+
+		bool     _filter       = false;
+		uint32_t _context      = 0;
+		uint32_t _context_mask = 0;
+
+		Oa_counters   _counters;
+		unsigned long _reports  = 0;
+		unsigned long _filtered = 0;
+		unsigned long _invalid  = 0;
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param base  local address of the buffer
+		 * \param size  multiple of the report size
+		 */
+		Oa_buffer(void *base, size_t size)
+		: _base ((uint8_t *)base), _size (size) { }
+
+		/**
+		 * Only aggregate deltas of the context with the ID 'context'
+		 *
+		 * \param mask  bits of the context ID to compare, the lower bits of
+		 *              the ID may be used by the hardware
+		 */
+		void filter(uint32_t context, uint32_t mask = ~0U)
+		{
+			_filter       = true;
+			_context      = context & mask;
+			_context_mask = mask;
+		}
+
+		void no_filter() { _filter = false; }
+
+		/**
+		 * Decode and aggregate reports from offset 'head' to 'tail'
+		 *
+		 * Consumed slots are zeroed. The OA unit may advance its tail
+		 * before the report reached memory, so a zero slot marks a report
+		 * that was lost this way.
+		 *
+		 * \return  offset of the next report to consume
+		 */
+		size_t consume(size_t head, size_t tail)
+		{
+			for (; head != tail; head = (head + Oa_report::SIZE) % _size) {
+
+				Oa_report const cur (_base + head);
+
+				if (!cur.valid()) {
+					_invalid++;
+					_have_last = false;
+					continue;
+				}
+
+				_reports++;
+
+				if (_have_last) {
+					Oa_report const prev (_last);
+
+					if (!_filter || (prev.context_id() & _context_mask) == _context)
+						_counters.add (prev, cur);
+					else
+						_filtered++;
+				}
+
+				memcpy (_last, _base + head, Oa_report::SIZE);
+				memset (_base + head, 0, Oa_report::SIZE);
+				_have_last = true;
+			}
+
+			return head;
+		}
+
+		/**
+		 * Forget the last report, e.g., after reports were lost
+		 */
+		void restart() { _have_last = false; }
+
+		Oa_counters       &counters()       { return _counters; }
+		Oa_counters const &counters() const { return _counters; }
+
+		unsigned long reports()  const { return _reports; }
+		unsigned long filtered() const { return _filtered; }
+		unsigned long invalid()  const { return _invalid; }
+};
+
+#endif /* _OA_H_ */
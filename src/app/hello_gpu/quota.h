@@ -0,0 +1,148 @@
+/*
+ * \brief  Quota donation to the platform driver
+ * \author Alexander Senier
+ * \date   2017-01-20
+ */
+
+/*
+ * DMA buffers and their metadata are accounted to our platform session. If
+ * the session runs out of quota, the platform driver throws an exception and
+ * we need to upgrade the session via the parent. Reacting to exceptions only
+ * costs several round-trips for large allocations. The quota manager thus
+ * donates the expected working set up front, tracks consumed versus donated
+ * quota, and tops up with a single upgrade sized to the pending request.
+ * The exception path is kept as a fallback and counted.
+ */
+
+#ifndef _QUOTA_H_
+#define _QUOTA_H_
+
+#include <base/env.h>
+#include <base/log.h>
+#include <session/capability.h>
+#include <util/retry.h>
+#include <util/string.h>
+
+namespace Genode {
+
+	class Quota_manager;
+}
+
+class Genode::Quota_manager
+{
+	public:
+
+		/* Quota estimated for the session's metadata per request */
+		enum { METADATA_OVERHEAD = 4096 };
+
+	private:
+
+		Env                &_env;
+		Session_capability  _session;
+
+		size_t _donated  = 0;
+		size_t _consumed = 0;
+
+		unsigned long _upgrades = 0;
+		unsigned long _retries  = 0;
+
+		void _upgrade(size_t amount)
+		{
+			char quota[32];
+			Genode::snprintf(quota, sizeof(quota), "ram_quota=%ld", amount);
+			_env.parent().upgrade(_session, quota);
+
+			_donated += amount;
+			_upgrades++;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param working_set  quota donated to the session up front
+		 */
+		Quota_manager(Env &env, Session_capability session, size_t working_set)
+		:
+			_env (env), _session (session)
+		{
+			if (working_set)
+				_upgrade(working_set);
+		}
+
+		/**
+		 * Perform session request that consumes 'size' bytes of quota
+		 *
+		 * If the quota not consumed yet does not cover the request, the
+		 * session is upgraded by the missing amount in one call. Should the
+		 * session still report exception 'EXC', it is upgraded by the full
+		 * request size and the request is retried.
+		 *
+		 * 'func' returns a capability. If it is invalid or 'func' throws,
+		 * the quota is not consumed. Otherwise, 'release' must be called
+		 * with the same 'size' later.
+		 */
+		template <typename EXC, typename FUNC>
+		auto consume(size_t size, FUNC const &func) -> decltype(func())
+		{
+			size_t const needed = size + METADATA_OVERHEAD;
+
+			if (_consumed + needed > _donated)
+				_upgrade(_consumed + needed - _donated);
+
+			_consumed += needed;
+
+			try {
+				auto const result = Genode::retry<EXC>(func, [&] () {
+					_retries++;
+					_upgrade(needed);
+				});
+
+				if (!result.valid())
+					release(size);
+
+				return result;
+
+			} catch (...) {
+				release(size);
+				throw;
+			}
+		}
+
+		/**
+		 * Perform session request that consumes no quota permanently
+		 *
+		 * The session is upgraded only if it reports exception 'EXC'.
+		 */
+		template <typename EXC, typename FUNC>
+		auto request(FUNC const &func) -> decltype(func())
+		{
+			return Genode::retry<EXC>(func, [&] () {
+				_retries++;
+				_upgrade(METADATA_OVERHEAD);
+			});
+		}
+
+		/**
+		 * Account release of a request of 'size' bytes
+		 */
+		void release(size_t size)
+		{
+			size_t const freed = size + METADATA_OVERHEAD;
+			_consumed = _consumed > freed ? _consumed - freed : 0;
+		}
+
+		size_t        donated()  const { return _donated; }
+		size_t        consumed() const { return _consumed; }
+		unsigned long upgrades() const { return _upgrades; }
+		unsigned long retries()  const { return _retries; }
+
+		void print_stats() const
+		{
+			log ("Quota: donated=", _donated, " consumed=", _consumed,
+			     " upgrades=", _upgrades, " retries=", _retries);
+		}
+};
+
+#endif /* _QUOTA_H_ */
@@ -0,0 +1,142 @@
+/*
+ * \brief  Producer side of a GPU ring buffer
+ * \author Alexander Senier
+ * \date   2017-01-11
+ */
+
+/*
+ * The ring buffer is shared between the CPU, which appends commands, and the
+ * command streamer of the GPU, which consumes them. The producer writes
+ * commands at its private tail and makes a whole batch of them visible to the
+ * GPU at once by publishing the tail (i.e. by a single tail update in the
+ * context image). The consumer reports its progress through the head offset.
+ *
+ * Offsets are byte offsets into the ring. The tail must always be QWord
+ * aligned and one QWord is kept free, so that a full ring can be told apart
+ * from an empty one (head == tail).
+ */
+
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <util/string.h>
+
+namespace Genode {
+
+	class Ring_buffer;
+}
+
+class Genode::Ring_buffer
+{
+	public:
+
+		enum { ALIGNMENT = 8 };
+
+	private:
+
+		uint8_t * const _base;
+		size_t    const _size;
+
+		size_t _head      = 0; /* last known consumer offset   */
+		size_t _tail      = 0; /* private producer offset      */
+		size_t _published = 0; /* tail offset visible to GPU   */
+
+		size_t _used() const { return (_tail + _size - _head) % _size; }
+
+	public:
+
+		Ring_buffer(void *base, size_t size)
+		:
+			_base ((uint8_t *)base),
+			_size (size)
+		{
+			assert (size % ALIGNMENT == 0);
+		}
+
+		/**
+		 * Update consumer offset as reported by the GPU
+		 */
+		void head(size_t offset) { _head = offset % _size; }
+
+		size_t head()      const { return _head; }
+		size_t tail()      const { return _tail; }
+		size_t published() const { return _published; }
+		size_t size()      const { return _size; }
+
+		/**
+		 * Number of bytes that can be reserved without overwriting commands
+		 * not yet consumed by the GPU
+		 */
+		size_t avail() const { return _size - _used() - ALIGNMENT; }
+
+		/**
+		 * Number of bytes appended but not yet published
+		 */
+		size_t pending() const { return (_tail + _size - _published) % _size; }
+
+		/**
+		 * True if the GPU consumed everything that was published
+		 */
+		bool idle() const { return _head == _published; }
+
+		/**
+		 * Reserve space for commands of 'size' bytes
+		 *
+		 * Commands never straddle the end of the ring. If the requested space
+		 * does not fit before the end, the remainder is filled with MI_NOOP
+		 * (which encodes as 0) and the space is reserved at the start.
+		 *
+		 * \return  pointer to reserved space or nullptr if the ring is
+		 *          full and the caller must wait for the GPU to advance
+		 */
+		void *reserve(size_t size)
+		{
+			assert (size % ALIGNMENT == 0);
+
+			size_t const to_end = _size - _tail;
+			size_t const needed = size <= to_end ? size : size + to_end;
+
+			if (needed > avail())
+				return nullptr;
+
+			if (size > to_end) {
+				memset(_base + _tail, 0, to_end);
+				_tail = 0;
+			}
+
+			void *result = _base + _tail;
+			_tail = (_tail + size) % _size;
+			return result;
+		}
+
+		/**
+		 * Append a single command
+		 *
+		 * \return  false if the ring is full
+		 */
+		template <typename T>
+		bool append(T const &command)
+		{
+			static_assert (sizeof(T) % ALIGNMENT == 0, "Command not QWord aligned");
+
+			void *dst = reserve(sizeof(T));
+			if (!dst)
+				return false;
+
+			*(T *)dst = command;
+			return true;
+		}
+
+		/**
+		 * Make all pending commands visible to the GPU
+		 *
+		 * \return  tail offset to be written to the context
+		 */
+		size_t publish()
+		{
+			_published = _tail;
+			return _published;
+		}
+};
+
+#endif /* _RING_BUFFER_H_ */
@@ -0,0 +1,385 @@
+/*
+ * \brief  Execlist scheduler
+ * \author Alexander Senier
+ * \date   2017-01-12
+ */
+
+/*
+ * The execlist submit port holds two elements. The hardware switches to
+ * element 1 as soon as element 0 completes, so keeping both elements filled
+ * avoids idle gaps between contexts. When new jobs are appended to a context
+ * that is already in the port, the same context is submitted again with the
+ * new tail (lite restore). If it is executing, the hardware just picks up
+ * the new tail without saving and restoring the context.
+ *
+ * Completion of element 0 is taken from the context status buffer in the
+ * order the hardware signals it, so that the view of the port stays in sync.
+ *
+ * Every engine has its own port and context status buffer and thus its own
+ * scheduler.
+ *
+ * Contexts of higher priority always run first. A newly runnable context
+ * preempts element 0 right away if its priority is higher. Contexts of the
+ * same priority share the engine by weight. The weight belongs to a weight
+ * group, e.g., all contexts of one client, which accumulates virtual
+ * runtime, i.e., the GPU time of all its contexts divided by its weight.
+ * The group with the least virtual runtime is preferred. Within a group,
+ * each context accumulates virtual runtime of its own with an equal share
+ * of the group's weight. When a context becomes runnable, the virtual
+ * runtime of its group is raised to the minimum of the running groups, so
+ * idle time is not credited.
+ *
+ * GPU time is taken from the context timestamp. The GPU saves it to the
+ * context image when it switches the context out, i.e., on completion or
+ * preemption other than by lite restore. The image is read only then, as
+ * it is stale while the context executes. The timestamp of the executing
+ * context is read from the engine's register.
+ *
+ * On every expired timeslice, the port is compared to the queue. If a
+ * waiting context or element 1 is preferred over element 0, all port
+ * elements are put back into the queue and the port is resubmitted in
+ * order of preference. The hardware preempts element 0 at its next
+ * arbitration point. Timeslices only need to expire while a context waits
+ * behind element 0, so the timer is armed only then.
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <util/fifo.h>
+#include <igd.h>
+#include <submission.h>
+#include <context_status.h>
+#include <event_trace.h>
+
+namespace Genode {
+
+	class Execlist_scheduler;
+}
+
+class Genode::Execlist_scheduler
+{
+	public:
+
+		/*
+		 * One-shot timer calling 'timeslice' when expired
+		 */
+		struct Timeslice_timer
+		{
+			/**
+			 * Arm timer unless it is armed already
+			 */
+			virtual void arm() = 0;
+		};
+
+	private:
+
+		IGD                   &_igd;
+		Engine const           _engine;
+		Context_status_buffer &_csb;
+		Fifo<Submission>       _queue;
+		Submission            *_port[2] = { nullptr, nullptr };
+
+		Genode::uint64_t       _min_vruntime = 0;
+		unsigned long          _preemptions  = 0;
+
+		Timeslice_timer       *_timer = nullptr;
+
+		void _arm_timer()
+		{
+			if (_timer && contended())
+				_timer->arm();
+		}
+
+		bool _in_port(Submission const *s) const
+		{
+			return s == _port[0] || s == _port[1];
+		}
+
+		static bool _preferred(Submission const &a, Submission const &b)
+		{
+			if (a.priority() != b.priority())
+				return a.priority() > b.priority();
+
+			if (&a.group() != &b.group())
+				return a.group().vruntime < b.group().vruntime;
+
+			return a.vruntime() < b.vruntime();
+		}
+
+		/*
+		 * Most preferred context of the queue
+		 *
+		 * Contexts that completed all their jobs while waiting, e.g.,
+		 * after being preempted, are dropped from the queue.
+		 */
+		Submission *_best()
+		{
+			Submission *best = nullptr;
+
+			for (Submission *s = _queue.head(), *next; s; s = next) {
+				next = s->next();
+
+				if (s->idle()) {
+					_queue.remove(s);
+					continue;
+				}
+
+				if (!best || _preferred(*s, *best))
+					best = s;
+			}
+			return best;
+		}
+
+		/*
+		 * Charge GPU time up to 'timestamp' to the virtual runtime of 's'
+		 * and its weight group
+		 */
+		static void _account(Submission &s, Genode::uint32_t timestamp)
+		{
+			Genode::uint64_t const delta = s.account(timestamp);
+			s.vruntime(s.vruntime() + delta * Submission::DEFAULT_WEIGHT / s.weight());
+			s.group().vruntime += delta * Submission::DEFAULT_WEIGHT / s.group().weight;
+		}
+
+		Submission *_lookup(unsigned int id)
+		{
+			for (Submission *s : _port)
+				if (s && s->id() == id)
+					return s;
+
+			for (Submission *s = _queue.head(); s; s = s->next())
+				if (s->id() == id)
+					return s;
+
+			return nullptr;
+		}
+
+		void _submit()
+		{
+			if (_port[1])
+				_igd.submit_contexts (_engine, _port[0]->context_descriptor(),
+				                      _port[1]->context_descriptor());
+			else
+				_igd.submit_contexts (_engine, _port[0]->context_descriptor());
+		}
+
+		/*
+		 * Move the most preferred queued contexts into free port elements.
+		 * Element 0 is resubmitted along with a new element 1, which is a
+		 * lite restore if element 0 is currently executing.
+		 */
+		void _fill()
+		{
+			bool changed = false;
+
+			for (unsigned i = 0; i < 2; i++) {
+				if (_port[i])
+					continue;
+
+				Submission *s = _best();
+				if (!s)
+					break;
+
+				_queue.remove(s);
+				_port[i] = s;
+				changed  = true;
+			}
+
+			if (_port[0] && _port[0]->group().vruntime > _min_vruntime)
+				_min_vruntime = _port[0]->group().vruntime;
+
+			if (changed)
+				_submit();
+
+			_arm_timer();
+		}
+
+		/*
+		 * Return all port elements to the queue and resubmit the port in
+		 * order of preference
+		 */
+		void _preempt()
+		{
+			for (Submission *&s : _port) {
+				if (s)
+					_queue.enqueue(s);
+				s = nullptr;
+			}
+
+			_preemptions++;
+			_fill();
+		}
+
+	public:
+
+		Execlist_scheduler(IGD &igd, Engine engine, Context_status_buffer &csb)
+		: _igd (igd), _engine (engine), _csb (csb) { }
+
+		Engine engine() const { return _engine; }
+
+		/**
+		 * Set timer expiring timeslices
+		 */
+		void timeslice_timer(Timeslice_timer &timer)
+		{
+			_timer = &timer;
+			_arm_timer();
+		}
+
+		/**
+		 * Publish jobs of a submission and schedule its context
+		 */
+		void submit(Submission &submission)
+		{
+			assert (submission.engine() == _engine);
+
+			if (!submission.commit())
+				return;
+
+			/* Context already in port, update its tail by lite restore */
+			if (_in_port(&submission)) {
+				_submit();
+				return;
+			}
+
+			if (!submission.is_enqueued()) {
+				if (submission.group().vruntime < _min_vruntime)
+					submission.group().vruntime = _min_vruntime;
+				_queue.enqueue(&submission);
+			}
+
+			if (_port[0] && submission.priority() > _port[0]->priority()) {
+				_preempt();
+				return;
+			}
+
+			_fill();
+		}
+
+		/**
+		 * Timeslice of element 0 expired
+		 *
+		 * Element 0 is charged for the GPU time it consumed so far and is
+		 * preempted if another context is preferred now.
+		 */
+		void timeslice()
+		{
+			if (!_port[0])
+				return;
+
+			/* Only trust the timestamp if the context kept executing */
+			unsigned const id = _port[0]->id();
+			if (_igd.executing_context(_engine) == id) {
+				Genode::uint32_t const timestamp = _igd.context_timestamp(_engine);
+				if (_igd.executing_context(_engine) == id)
+					_account(*_port[0], timestamp);
+			}
+
+			Submission *best = _best();
+			if (_port[1] && (!best || _preferred(*_port[1], *best)))
+				best = _port[1];
+
+			if (best && _preferred(*best, *_port[0]))
+				_preempt();
+			else
+				_arm_timer();
+		}
+
+		/**
+		 * Element 0 of the port completed
+		 *
+		 * The former element 1 becomes element 0 and the port is refilled
+		 * from the queue.
+		 */
+		void complete()
+		{
+			Submission *done = _port[0];
+
+			_port[0] = _port[1];
+			_port[1] = nullptr;
+
+			/* Jobs published after the context was switched out */
+			if (done && !done->idle() && !done->is_enqueued())
+				_queue.enqueue(done);
+
+			_fill();
+		}
+
+		/**
+		 * Process pending context status events
+		 *
+		 * Completed contexts are retired from the port and every event is
+		 * passed on to 'fn'.
+		 *
+		 * \return  number of events processed
+		 */
+		template <typename FUNC>
+		unsigned int process(FUNC const &fn)
+		{
+			unsigned int const count =
+				_csb.process([&] (Context_status_buffer::Event const &event) {
+
+					/* The context image holds the timestamp saved on switch-out */
+					Submission *s = _lookup(event.context_id());
+					bool const switched_out = event.complete() ||
+					                          (event.preempted() && !event.lite_restore());
+					if (s && switched_out)
+						_account(*s, s->context_timestamp());
+
+					event_trace().record (Event_trace::CSB_EVENT, _engine,
+					                      event.context_id(), event.status());
+					if (s && event.complete())
+						event_trace().record (Event_trace::SEQNO, _engine, s->id(),
+						                      s->fence().completed());
+
+					if (event.complete() && _port[0] &&
+					    _port[0]->id() == event.context_id())
+						complete();
+
+					fn (event);
+				});
+
+			if (count)
+				_igd.context_status_read_pointer(_engine, _csb.read_pointer());
+
+			return count;
+		}
+
+		/**
+		 * Context currently executing (element 0), if any
+		 */
+		Submission *current() { return _port[0]; }
+
+		/**
+		 * True if a context waits behind element 0, i.e., in element 1 or
+		 * in the queue
+		 */
+		bool contended() { return _port[0] && (_port[1] || !_queue.empty()); }
+
+		/**
+		 * True if no context is in the port or waiting for it
+		 */
+		bool idle() { return !_port[0] && _queue.empty(); }
+
+		/**
+		 * True if 'submission' is in the port or waiting for it
+		 *
+		 * A submission that completed all jobs while waiting is dropped
+		 * from the queue.
+		 */
+		bool holds(Submission &submission)
+		{
+			if (_in_port(&submission))
+				return true;
+
+			if (submission.is_enqueued() && submission.idle())
+				_queue.remove(&submission);
+
+			return submission.is_enqueued();
+		}
+
+		unsigned long preemptions() const { return _preemptions; }
+};
+
+#endif /* _SCHEDULER_H_ */
@@ -0,0 +1,107 @@
+/*
+ * \brief  Simulated GPU service backend
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+/*
+ * Batches complete as soon as they are executed and buffers are plain RAM
+ * dataspaces. This allows for running the service and its clients without
+ * an IGD, e.g., in Qemu.
+ */
+
+#ifndef _SIM_BACKEND_H_
+#define _SIM_BACKEND_H_
+
+#include <base/env.h>
+#include <base/log.h>
+
+#include <gpu_backend.h>
+
+namespace Gpu {
+
+	class Sim_context;
+	class Sim_backend;
+}
+
+class Gpu::Sim_context : public Gpu::Context
+{
+	private:
+
+		Session::Seqno _seqno  = 0;
+		size_t         _mapped = 0;
+
+	public:
+
+		void map(addr_t, addr_t, size_t size, bool) override { _mapped += size; }
+
+		void unmap(addr_t, size_t size) override { _mapped -= size; }
+
+		bool exec(addr_t, Session::Seqno &seqno) override
+		{
+			seqno = ++_seqno;
+			notify();
+			return true;
+		}
+
+		Session::Seqno completed() const override { return _seqno; }
+
+		size_t mapped() const { return _mapped; }
+};
+
+class Gpu::Sim_backend : public Gpu::Backend
+{
+	private:
+
+		Genode::Env       &_env;
+		Genode::Allocator &_md_alloc;
+
+	public:
+
+		Sim_backend(Genode::Env &env, Genode::Allocator &md_alloc)
+		: _env (env), _md_alloc (md_alloc) { }
+
+		Context &alloc_context(Genode::Session_label const &) override
+		{
+			return *new (&_md_alloc) Sim_context();
+		}
+
+		void free_context(Context &context) override
+		{
+			Sim_context &c = static_cast<Sim_context &>(context);
+
+			if (c.mapped())
+				Genode::warning ("context freed with ", c.mapped(), " bytes mapped");
+
+			Genode::destroy (&_md_alloc, &c);
+		}
+
+		Genode::Ram_dataspace_capability alloc_buffer(size_t size) override
+		{
+			try {
+				return _env.ram().alloc (size);
+			} catch (Genode::Ram_session::Alloc_failed) {
+				return Genode::Ram_dataspace_capability();
+			}
+		}
+
+		void free_buffer(Genode::Ram_dataspace_capability ds) override
+		{
+			_env.ram().free (ds);
+		}
+
+		/* Batches complete on execution, so the buffer is free already */
+		void retire_buffer(Context &context, Genode::Ram_dataspace_capability ds,
+		                   addr_t ga, size_t size) override
+		{
+			if (size)
+				context.unmap (ga, size);
+
+			if (ds.valid())
+				free_buffer (ds);
+		}
+
+		bool unmapping(Context &, addr_t, size_t) override { return false; }
+};
+
+#endif /* _SIM_BACKEND_H_ */
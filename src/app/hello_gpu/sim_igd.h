@@ -0,0 +1,557 @@
+/*
+ * \brief  Software model of the IGD command streamers
+ * \author Alexander Senier
+ * \date   2017-01-30
+ */
+
+/*
+ * The model lets IGD, Submission and GPU_allocator run without an Intel GPU,
+ * e.g., on base-linux. The IGD operates on ordinary memory as BAR0 and
+ * reports execlist submissions to the model, which executes them like the
+ * command streamers would:
+ *
+ * - A submission is latched in the engine's execlist port and executed by
+ *   the next 'step', so the driver observes completion asynchronously.
+ * - The ring registers and PDP0 are restored from the LRI blocks of the
+ *   context image. The ring is executed from head to tail, and head and
+ *   context timestamp are saved back into the image.
+ * - MI_BATCH_BUFFER_START runs batches in the PPGTT or GGTT, including
+ *   second-level calls and chains. MI_STORE_DATA_IMM and the post-sync
+ *   writes of MI_FLUSH_DW and PIPE_CONTROL write memory, the model has no
+ *   caches to flush. Other commands are skipped by their length.
+ * - Context status events are written to the context status buffer in the
+ *   engine's hardware status page.
+ *
+ * Global graphics addresses are translated by the GGTT entries in the upper
+ * half of BAR0. The driver passes physical addresses for context images,
+ * rings and status pages, so addresses without a present GGTT entry are
+ * taken as physical. Physical addresses are resolved through
+ * 'Translation_table_allocator::virt_addr'. The PPGTT is walked as 4-level
+ * IA-32e table with 2 MiB and 1 GiB pages.
+ *
+ * Interrupts are not modeled, completion is detected by polling the status
+ * page. The context timestamp counts executed commands.
+ */
+
+#ifndef _SIM_IGD_H_
+#define _SIM_IGD_H_
+
+#include <base/log.h>
+#include <translation_table_allocator.h>
+#include <igd.h>
+#include <ggtt.h>
+#include <context.h>
+#include <context_status.h>
+#include <descriptor.h>
+#include <instructions.h>
+#include <engine.h>
+
+namespace Genode {
+
+	class Sim_igd;
+}
+
+class Genode::Sim_igd : public IGD::Engine_model
+{
+	public:
+
+		/* Registers in the lower half, GGTT in the upper half */
+		enum { BAR_SIZE = 2 * IGD::GTT_OFFSET };
+
+	private:
+
+		enum {
+			PAGE_SIZE_LOG2 = 12,
+			PAGE_SIZE      = 1UL << PAGE_SIZE_LOG2,
+
+			/* Bound on commands per ring, catches runaway batches */
+			MAX_COMMANDS   = 1UL << 20,
+		};
+
+		/* Ring registers restored from the context image */
+		enum {
+			RING_TAIL      = 0x030,
+			RING_HEAD      = 0x034,
+			RING_START     = 0x038,
+			RING_CTL       = 0x03c,
+			RING_PDP0_LDW  = 0x270,
+			RING_PDP0_UDW  = 0x274,
+			RING_TIMESTAMP = 0x3a8,
+		};
+
+		/* Engine registers updated for the driver */
+		enum {
+			EXECLIST_STATUS_HI = 0x238,
+			CTX_TIMESTAMP      = 0x3a8,
+		};
+
+		struct Pte : Register<64>
+		{
+			struct Present   : Bitfield< 0,  1> { };
+			struct Page_size : Bitfield< 7,  1> { };
+			struct Address   : Bitfield<12, 36> { };
+		};
+
+		typedef Op_header::Command_type      Command_type;
+		typedef Op_header::Mi_command_opcode Opcode;
+
+		typedef Context_status_buffer       Csb;
+		typedef Csb::Status                 Status;
+
+		/*
+		 * Registers of a context, pointing to the values in its image
+		 */
+		struct Context
+		{
+			Engine            engine    = NUM_ENGINES;
+			unsigned          id        = 0;
+			Genode::uint32_t *tail      = nullptr;
+			Genode::uint32_t *head      = nullptr;
+			Genode::uint32_t *start     = nullptr;
+			Genode::uint32_t *control   = nullptr;
+			Genode::uint32_t *pdp0_ldw  = nullptr;
+			Genode::uint32_t *pdp0_udw  = nullptr;
+			Genode::uint32_t *timestamp = nullptr;
+
+			bool valid() const {
+				return tail && head && start && control && pdp0_ldw && pdp0_udw && timestamp; }
+
+			addr_t pml4() const { return (addr_t)*pdp0_udw << 32 | *pdp0_ldw; }
+		};
+
+		struct Engine_state
+		{
+			Genode::uint32_t volatile *hwsp = nullptr;
+
+			unsigned csb_write = Csb::ENTRIES - 1;
+
+			/* Latched execlist port */
+			Context_descriptor port[2] {
+				Context_descriptor (0, 0, 0, false),
+				Context_descriptor (0, 0, 0, false) };
+			bool pending = false;
+		};
+
+		Translation_table_allocator &_allocator;
+		addr_t const                 _bar;
+		Engine_state                 _engines[NUM_ENGINES];
+
+		unsigned long _commands = 0;
+		unsigned long _batches  = 0;
+		unsigned long _faults   = 0;
+
+		Genode::uint32_t volatile &_reg(Engine e, addr_t offset) {
+			return *(Genode::uint32_t volatile *)(_bar + ring_base (e) + offset); }
+
+		void *_phys(addr_t pa) { return pa ? _allocator.virt_addr ((void *)pa) : nullptr; }
+
+		void *_ggtt(addr_t ga)
+		{
+			Genode::uint64_t const pte =
+				((Genode::uint64_t volatile *)(_bar + IGD::GTT_OFFSET))[ga >> PAGE_SIZE_LOG2];
+
+			if (!Ggtt::Pte::Present::get (pte))
+				return _phys (ga);
+
+			return _phys (Ggtt::Pte::Address::masked (pte) | (ga & (PAGE_SIZE - 1)));
+		}
+
+		void *_ppgtt(addr_t pml4, addr_t ga)
+		{
+			addr_t table = pml4;
+
+			for (unsigned level = 0; level < 4; level++) {
+
+				unsigned const shift = 39 - 9 * level;
+
+				Genode::uint64_t const *entries = (Genode::uint64_t const *)_phys (table);
+				if (!entries)
+					return nullptr;
+
+				Genode::uint64_t const e = entries[(ga >> shift) & 0x1ff];
+				if (!Pte::Present::get (e))
+					return nullptr;
+
+				addr_t const mask = (1UL << shift) - 1;
+
+				/* 4 KiB page, or 1 GiB and 2 MiB page in PDPT and PD */
+				if (level == 3 || (level > 0 && Pte::Page_size::get (e)))
+					return _phys ((Pte::Address::masked (e) & ~mask) | (ga & mask));
+
+				table = Pte::Address::masked (e);
+			}
+			return nullptr;
+		}
+
+		Genode::uint32_t *_dword(Context const &c, addr_t ga, bool ppgtt)
+		{
+			void *p = ppgtt ? _ppgtt (c.pml4(), ga) : _ggtt (ga);
+			if (!p) {
+				_faults++;
+				event_trace().record (Event_trace::FAULT, c.engine, c.id, ga);
+			}
+			return (Genode::uint32_t *)p;
+		}
+
+		/*
+		 * Length of a command in DWords
+		 */
+		static unsigned _length(Genode::uint32_t header)
+		{
+			if (Command_type::get (header) == Command_type::MI_COMMAND &&
+			    Opcode::get (header) < 0x10)
+				return 1;
+
+			return (header & 0xff) + 2;
+		}
+
+		static bool _mi(Genode::uint32_t header, unsigned opcode)
+		{
+			return Command_type::get (header) == Command_type::MI_COMMAND &&
+			       Opcode::get (header) == opcode;
+		}
+
+		/*
+		 * Read the registers of a context from the LRI blocks of its image
+		 */
+		bool _restore(Engine e, Context_descriptor d, Context &c)
+		{
+			Genode::uint8_t *image = (Genode::uint8_t *)_ggtt (d.lrca());
+			if (!image)
+				return false;
+
+			Genode::uint64_t *q   = (Genode::uint64_t *)(image + Execlist_context::STATE_OFFSET);
+			Genode::uint64_t *end = q + PAGE_SIZE / sizeof (*q);
+
+			while (q < end) {
+
+				Genode::uint32_t const header = (Genode::uint32_t)*q++;
+
+				if (header == 0)
+					continue;
+
+				if (!_mi (header, Opcode::MI_LOAD_REGISTER_IMM))
+					break;
+
+				for (unsigned n = ((header & 0xff) + 1) / 2; n && q < end; n--, q++) {
+
+					Genode::uint32_t *value = (Genode::uint32_t *)q;
+
+					switch ((addr_t)(*q >> 32) - ring_base (e)) {
+					case RING_TAIL:      c.tail      = value; break;
+					case RING_HEAD:      c.head      = value; break;
+					case RING_START:     c.start     = value; break;
+					case RING_CTL:       c.control   = value; break;
+					case RING_PDP0_LDW:  c.pdp0_ldw  = value; break;
+					case RING_PDP0_UDW:  c.pdp0_udw  = value; break;
+					case RING_TIMESTAMP: c.timestamp = value; break;
+					default: break;
+					}
+				}
+			}
+
+			c.engine = e;
+			c.id     = d.id();
+			return c.valid();
+		}
+
+		void _store(Context const &c, Genode::uint32_t const *cmd)
+		{
+			typedef Mi_store_data_imm::Header Header;
+
+			addr_t const ga = ((addr_t)cmd[2] << 32 | cmd[1]) & ~3UL;
+			bool   const ppgtt = !Header::Use_global_gtt::get (cmd[0]);
+
+			Genode::uint32_t *dst = _dword (c, ga, ppgtt);
+			if (!dst)
+				return;
+
+			dst[0] = cmd[3];
+			if (Header::Store_qword::get (cmd[0]))
+				dst[1] = cmd[4];
+		}
+
+		static bool _pipe_control(Genode::uint32_t header)
+		{
+			typedef Pipe_control::Header Header;
+
+			return Command_type::get (header) == Command_type::GFXPIPE &&
+			       Header::Command_subtype::get (header) == Header::Command_subtype::GFXPIPE_3D &&
+			       Header::Opcode::get (header) == Header::Opcode::PIPE_CONTROL;
+		}
+
+		/*
+		 * Post-sync write of MI_FLUSH_DW or PIPE_CONTROL
+		 */
+		void _post_sync(Context const &c, Genode::uint32_t const *cmd)
+		{
+			addr_t           ga;
+			bool             ppgtt;
+			Genode::uint32_t value;
+
+			if (_mi (cmd[0], Opcode::MI_FLUSH_DW)) {
+				typedef Mi_flush_dw::Header  Header;
+				typedef Mi_flush_dw::Address Address;
+
+				if (!Header::Post_sync_operation::get (cmd[0]))
+					return;
+
+				ga    = ((addr_t)cmd[2] << 32 | cmd[1]) & ~7UL;
+				ppgtt = !Address::Destination_address_type::get (cmd[1]);
+				value = cmd[3];
+			} else if (_pipe_control (cmd[0])) {
+				typedef Pipe_control::Flags Flags;
+
+				if (!Flags::Post_sync_operation::get (cmd[1]))
+					return;
+
+				ga    = ((addr_t)cmd[3] << 32 | cmd[2]) & ~7UL;
+				ppgtt = !Flags::Destination_address_type::get (cmd[1]);
+				value = cmd[4];
+			} else
+				return;
+
+			Genode::uint32_t *dst = _dword (c, ga, ppgtt);
+			if (dst)
+				dst[0] = value;
+		}
+
+		/*
+		 * Execute first-level batch at 'ga'
+		 *
+		 * \return  number of commands executed
+		 */
+		unsigned long _batch(Context const &c, addr_t ga, bool ppgtt)
+		{
+			typedef Mi_batch_buffer_start::Header Header;
+
+			/* Return address of a second-level call */
+			bool   second       = false;
+			addr_t return_ga    = 0;
+			bool   return_ppgtt = false;
+
+			_batches++;
+
+			unsigned long count;
+			for (count = 0; count < MAX_COMMANDS; count++) {
+
+				Genode::uint32_t cmd[5] = { };
+				Genode::uint32_t *first = _dword (c, ga, ppgtt);
+				if (!first)
+					return count;
+
+				unsigned const len = _length (*first);
+				for (unsigned i = 0; i < len && i < 5; i++) {
+					Genode::uint32_t const *dw = _dword (c, ga + 4 * i, ppgtt);
+					if (!dw)
+						return count;
+					cmd[i] = *dw;
+				}
+
+				if (_mi (cmd[0], Opcode::MI_BATCH_BUFFER_END)) {
+					if (!second)
+						return count + 1;
+
+					second = false;
+					ga     = return_ga;
+					ppgtt  = return_ppgtt;
+					continue;
+				}
+
+				if (_mi (cmd[0], Opcode::MI_BATCH_BUFFER_START)) {
+
+					/* A second-level batch chains to further ones */
+					if (Header::Second_level_batch_buffer::get (cmd[0]) && !second) {
+						second       = true;
+						return_ga    = ga + 4 * len;
+						return_ppgtt = ppgtt;
+					}
+
+					ga    = ((addr_t)cmd[2] << 32 | cmd[1]) & ~3UL;
+					ppgtt = Header::Address_space_indicator::get (cmd[0]);
+					continue;
+				}
+
+				if (_mi (cmd[0], Opcode::MI_STORE_DATA_IMM))
+					_store (c, cmd);
+
+				_post_sync (c, cmd);
+
+				ga += 4 * len;
+			}
+
+			Genode::error ("batch of context ", c.id, " does not end");
+			return count;
+		}
+
+		/*
+		 * Execute ring of context from head to tail
+		 */
+		void _run(Engine e, Context const &c)
+		{
+			typedef Mi_batch_buffer_start::Header Header;
+
+			addr_t const start = *c.start & ~(PAGE_SIZE - 1);
+			size_t const size  = (((*c.control >> 12) & 0x1ff) + 1) * PAGE_SIZE;
+
+			addr_t       head  = *c.head & 0x1ffffc;
+			addr_t const tail  = *c.tail & 0x1ffff8;
+
+			unsigned long count = 0;
+
+			for (; head != tail && count < MAX_COMMANDS; count++) {
+
+				Genode::uint32_t cmd[5] = { };
+				unsigned len = 1;
+
+				for (unsigned i = 0; i < len && i < 5; i++) {
+					Genode::uint32_t const *dw = _dword (c, start + (head + 4 * i) % size, false);
+					if (!dw)
+						return;
+					cmd[i] = *dw;
+					if (i == 0)
+						len = _length (cmd[0]);
+				}
+
+				if (_mi (cmd[0], Opcode::MI_BATCH_BUFFER_START))
+					count += _batch (c, ((addr_t)cmd[2] << 32 | cmd[1]) & ~3UL,
+					                 Header::Address_space_indicator::get (cmd[0]));
+
+				if (_mi (cmd[0], Opcode::MI_STORE_DATA_IMM))
+					_store (c, cmd);
+
+				_post_sync (c, cmd);
+
+				head = (head + 4 * len) % size;
+			}
+
+			_commands += count;
+
+			/* Save head and timestamp into the context image */
+			*c.head       = (*c.head & ~0x1ffffcU) | (Genode::uint32_t)head;
+			*c.timestamp += count;
+
+			_reg (e, CTX_TIMESTAMP) = *c.timestamp;
+		}
+
+		void _event(Engine e, Status::access_t status, unsigned id)
+		{
+			Engine_state &s = _engines[e];
+			if (!s.hwsp)
+				return;
+
+			s.csb_write = (s.csb_write + 1) % Csb::ENTRIES;
+
+			s.hwsp[Csb::HWSP_CSB_BUF0_INDEX + 2 * s.csb_write]     = status;
+			s.hwsp[Csb::HWSP_CSB_BUF0_INDEX + 2 * s.csb_write + 1] = id;
+			s.hwsp[Csb::HWSP_CSB_WRITE_INDEX]                      = s.csb_write;
+		}
+
+		void _execute(Engine e)
+		{
+			Engine_state &s = _engines[e];
+			s.pending = false;
+
+			bool     active  = false;
+			unsigned last_id = 0;
+
+			for (Context_descriptor &d : s.port) {
+
+				if (!d.valid())
+					continue;
+
+				Context c;
+				if (!_restore (e, d, c)) {
+					Genode::error (engine_name (e), ": invalid context image of context ", d.id());
+					_faults++;
+					continue;
+				}
+
+				if (!active)
+					_event (e, Status::Idle_to_active::bits (1), c.id);
+				else
+					_event (e, Status::Context_complete::bits (1) |
+					           Status::Element_switch::bits (1), last_id);
+
+				active  = true;
+				last_id = c.id;
+
+				_reg (e, EXECLIST_STATUS_HI) = c.id;
+				_run (e, c);
+			}
+
+			if (active)
+				_event (e, Status::Context_complete::bits (1) |
+				           Status::Active_to_idle::bits (1), last_id);
+
+			_reg (e, EXECLIST_STATUS_HI) = 0;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param allocator  allocator of all DMA memory used by the driver,
+		 *                   resolves physical addresses
+		 * \param bar        local address of BAR_SIZE bytes of memory used
+		 *                   as BAR0 of the IGD
+		 */
+		Sim_igd(Translation_table_allocator &allocator, addr_t bar)
+		: _allocator (allocator), _bar (bar) { }
+
+		/**
+		 * Execute all contexts submitted since the last step
+		 *
+		 * \return  true if any engine executed a submission
+		 */
+		bool step()
+		{
+			bool executed = false;
+
+			for (unsigned e = 0; e < NUM_ENGINES; e++)
+				if (_engines[e].pending) {
+					_execute ((Engine)e);
+					executed = true;
+				}
+
+			return executed;
+		}
+
+		unsigned long commands() const { return _commands; }
+		unsigned long batches()  const { return _batches; }
+		unsigned long faults()   const { return _faults; }
+
+
+		/******************
+		 ** Engine_model **
+		 ******************/
+
+		void setup(Engine e, addr_t hwsp) override
+		{
+			Engine_state &s = _engines[e];
+
+			/* Like the hardware, leave the status page to the driver */
+			s.hwsp      = (Genode::uint32_t volatile *)_ggtt (hwsp);
+			s.csb_write = Csb::ENTRIES - 1;
+		}
+
+		void submit(Engine e, Context_descriptor element0,
+		            Context_descriptor element1) override
+		{
+			Engine_state &s = _engines[e];
+
+			/* A submission not executed yet is replaced */
+			s.port[0] = element0;
+			s.port[1] = element1;
+			s.pending = true;
+		}
+
+		/* The model caches no translations, the invalidation is done at once */
+		void invalidate_tlb(Engine e) override
+		{
+			*(Genode::uint32_t volatile *)(_bar + IGD::tlb_control (e)) = 0;
+		}
+};
+
+#endif /* _SIM_IGD_H_ */
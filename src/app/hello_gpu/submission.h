@@ -7,76 +7,364 @@
 #ifndef _SUBMISSION_H_
 #define _SUBMISSION_H_
 
+#include <util/misc_math.h>
+#include <util/fifo.h>
 #include <spec/x86_64/translation_table.h>
 #include <igd.h>
 #include <context.h>
 #include <descriptor.h>
 #include <instructions.h>
+#include <ring_buffer.h>
+#include <fence.h>
+#include <engine.h>
+#include <context_pool.h>
+#include <event_trace.h>
 
 namespace Genode {
 
+	struct Weight_group;
 	class Submission;
 }
 
-struct Genode::Submission
+/**
+ * Contexts sharing one weight, e.g., all contexts of a client
+ *
+ * The group is charged for the GPU time of all its contexts, so a client
+ * does not get a larger share of the GPU by creating more contexts.
+ */
+struct Genode::Weight_group
+{
+	unsigned         weight;
+	unsigned         members  = 0;
+	Genode::uint64_t vruntime = 0;
+
+	Weight_group(unsigned weight) : weight (weight) { }
+};
+
+struct Genode::Submission : Genode::Fifo<Submission>::Element
 {
+	public:
+
+		/* Weight of a context with an average share of the GPU */
+		enum { DEFAULT_WEIGHT = 1024 };
+
 	private:
 
-		using Ring_element = Mi_batch_buffer_start;
+		/*
+		 * Every job starts a batch buffer and then writes its sequence
+		 * number to the per-process hardware status page. The sequence
+		 * number is written by the post-sync operation of a flush, so a
+		 * signaled fence implies that all writes of the batch reached
+		 * memory. The render engine flushes by PIPE_CONTROL, all others
+		 * by MI_FLUSH_DW.
+		 */
+		struct Job
+		{
+			Mi_batch_buffer_start batch;
+			Mi_flush_dw           seqno;
+		};
+
+		struct Render_job
+		{
+			Mi_batch_buffer_start batch;
+			Pipe_control          seqno;
+		};
+
+		using Ring_element = Render_job;
+
+		/* PPGTT address of the per-process hardware status page */
+		enum { HWSP_GA = 0x1000 };
+
+		enum { PAGE_SIZE = 4096 };
 
 		IGD 		  &_igd;
+		Engine const       _engine;
+
+		Context_pool                &_pool;
+		Context_pool::Context const  _context;
+
 		Translation_table *_ppgtt;
 
 		addr_t _ppgtt_phys;
 
-		Ring_element *_ring;
+		void  *_ring_base;
 		size_t _ring_len;
 		addr_t _ring_phys;
 
-		Rcs_context  *_ctx;
+		Execlist_context *_ctx;
 		addr_t	      _ctx_phys;
 
 		Translation_table_allocator *_allocator;
 
+		Ring_buffer _ring;
+
+		unsigned int _id;
+
+		Fence             _fence;
+		Genode::uint32_t  _seqno           = 0;
+		Genode::uint32_t  _published_seqno = 0;
+
+		/*
+		 * Scheduling parameters, GPU time consumed in context timestamp
+		 * ticks, and the runtime weighted by the scheduler
+		 */
+		unsigned          _priority  = 0;
+		Weight_group      _own_group { DEFAULT_WEIGHT };
+		Weight_group     *_group     = &_own_group;
+		Genode::uint32_t  _timestamp = 0;
+		Genode::uint64_t  _runtime   = 0;
+		Genode::uint64_t  _vruntime  = 0;
+
+		/*
+		 * The hardware requires the ring buffer to be a multiple of the page
+		 * size. The remainder of the last page is used for additional slots.
+		 */
+		static size_t _ring_size(unsigned int num_elements)
+		{
+			return align_addr(num_elements * sizeof(Ring_element), 12);
+		}
+
 	public:
-		Submission(Translation_table_allocator *allocator, IGD &igd, unsigned int num_elements)
+		/**
+		 * Constructor
+		 *
+		 * \param pool  pool providing context image, ring and PPGTT
+		 */
+		Submission(Translation_table_allocator *allocator, Context_pool &pool,
+		           IGD &igd, Engine engine, unsigned int num_elements, unsigned int id)
 		:
 			_igd (igd),
-			_ring_len (num_elements * sizeof(Ring_element)),
-			_allocator (allocator)
+			_engine (engine),
+			_pool (pool),
+			_context (pool.acquire (engine, _ring_size (num_elements))),
+			_ppgtt (_context.ppgtt),
+			_ppgtt_phys ((addr_t)allocator->phys_addr (_ppgtt)),
+			_ring_base (_context.ring),
+			_ring_len (_context.ring_len),
+			_ring_phys ((addr_t)allocator->phys_addr (_ring_base)),
+			_ctx (_context.image),
+			_ctx_phys ((addr_t)allocator->phys_addr (_ctx)),
+			_allocator (allocator),
+			_ring (_ring_base, _ring_len),
+			_id (id),
+			_fence (_ctx->status_page())
+		{
+			_group->members++;
+
+			/* A recycled status page holds the sequence number of its last user */
+			_ctx->status_page()[Fence::HWSP_SEQNO_INDEX] = 0;
+
+			/* The status page stays mapped in recycled PPGTTs */
+			if (_context.recycled)
+				return;
+
+			const Page_flags hwsp_flags = Page_flags
+				{ .writeable  = true,
+				  .executable = false,
+				  .privileged = true,
+				  .global     = false,
+				  .device     = false,
+				  .cacheable  = UNCACHED };
+
+			_ppgtt->insert_translation (HWSP_GA, _ctx_phys + Execlist_context::STATUS_PAGE_OFFSET,
+			                            4096, hwsp_flags, _allocator);
+		}
+
+		/**
+		 * Destructor
+		 *
+		 * The context must not be held by a scheduler anymore and all
+		 * mappings inserted by 'insert_translation' must be removed.
+		 */
+		~Submission()
 		{
-			_ppgtt	    = new (_allocator) Translation_table();
-			_ppgtt_phys = (addr_t)_allocator->phys_addr (_ppgtt);
+			_group->members--;
+			_pool.release (_engine, _context);
+		}
 
-			_ring	   = (Ring_element *)_allocator->alloc (_ring_len);
-			_ring_phys = (addr_t)_allocator->phys_addr (_ring);
+		/**
+		 * Map 'size' bytes at physical address 'pa' to graphics address 'vo'
+		 *
+		 * The range is mapped by a single call. The translation table uses
+		 * 1 GiB and 2 MiB entries for all parts of the range where 'vo' and
+		 * 'pa' are aligned accordingly and 4 KiB entries for the rest.
+		 */
+		void insert_translation (addr_t vo, addr_t pa, size_t size, Page_flags const &flags)
+		{
+			assert (!((vo | pa | size) & (PAGE_SIZE - 1)));
 
-			_ctx	  = new (_allocator) Rcs_context (_ring_phys, _ring_len, _ppgtt_phys);
-			_ctx_phys = (addr_t)_allocator->phys_addr (_ctx);
+			_ppgtt->insert_translation (vo, pa, size, flags, _allocator);
 		}
 
-		void insert_translation (addr_t vo, addr_t pa, size_t size, Page_flags const &flags)	
+		/**
+		 * Remove mapping of 'size' bytes at graphics address 'vo'
+		 */
+		void remove_translation (addr_t vo, size_t size)
 		{
-			_ppgtt->insert_translation (vo, pa, 4096, flags, _allocator);
+			assert (!((vo | size) & (PAGE_SIZE - 1)));
+
+			_ppgtt->remove_translation (vo, size, _allocator);
 		}
 
-		void insert (addr_t graphics_address)
+		/**
+		 * Append a batch buffer to the ring
+		 *
+		 * The job is not visible to the GPU before 'commit' is called.
+		 *
+		 * \return  false if the ring is full, i.e. the GPU did not consume
+		 *          enough jobs yet
+		 */
+		bool insert (addr_t graphics_address)
 		{
 			const int level = Mi_batch_buffer_start::Header::Second_level_batch_buffer::FIRST_LEVEL_BATCH;
 			const int as    = Mi_batch_buffer_start::Header::Address_space_indicator::PPGTT;
-			_ring[0] = Mi_batch_buffer_start (graphics_address, level, as);
-			_ctx->tail_offset (sizeof(Mi_batch_buffer_start));
+
+			const int hwsp_as = Pipe_control::Flags::Destination_address_type::PPGTT;
+
+			addr_t           const hwsp_seqno = HWSP_GA + 4 * Fence::HWSP_SEQNO_INDEX;
+			Genode::uint32_t const seqno      = _seqno + 1;
+
+			Mi_batch_buffer_start const batch (graphics_address, level, as);
+
+			_ring.head (_ctx->head_offset());
+
+			bool const appended = _engine == RCS
+				? _ring.append (Render_job { batch, Pipe_control (hwsp_seqno, seqno, hwsp_as) })
+				: _ring.append (Job { batch, Mi_flush_dw (hwsp_seqno, seqno, hwsp_as) });
+
+			if (!appended)
+				return false;
+
+			_seqno = seqno;
+			event_trace().record (Event_trace::RING_INSERT, _engine, _id, seqno);
+			return true;
+		}
+
+		/**
+		 * Sequence number of the last inserted job
+		 */
+		Genode::uint32_t seqno() const { return _seqno; }
+
+		/**
+		 * Fence signaled by completion of jobs of this submission
+		 */
+		Fence const &fence() const { return _fence; }
+
+		/**
+		 * Publish all jobs inserted since the last commit with a single tail
+		 * update
+		 *
+		 * \return  true if new jobs were published
+		 */
+		bool commit()
+		{
+			if (!_ring.pending())
+				return false;
+
+			_ctx->tail_offset (_ring.publish());
+			_published_seqno = _seqno;
+			return true;
+		}
+
+		/**
+		 * True if the GPU completed all published jobs
+		 */
+		bool idle()
+		{
+			return _fence.signaled (_published_seqno);
 		}
 
 		Context_descriptor context_descriptor()
 		{
-			return Context_descriptor (0, 1, _ctx_phys);
+			return Context_descriptor (0, _id, _ctx_phys);
 		}
 
+		/**
+		 * ID of the context in OA reports and OACTXID, its LRCA
+		 */
+		Genode::uint32_t oa_context_id() const
+		{
+			return Context_descriptor (0, _id, _ctx_phys).lrca();
+		}
+
+		unsigned int id() const { return _id; }
+
+		Engine engine() const { return _engine; }
+
+		/**
+		 * Set scheduling parameters
+		 *
+		 * \param priority  contexts of higher priority always run first
+		 * \param weight    share of the GPU of the context's weight group
+		 *                  among contexts of the same priority relative to
+		 *                  DEFAULT_WEIGHT, 0 selects DEFAULT_WEIGHT
+		 */
+		void schedule(unsigned priority, unsigned weight)
+		{
+			_priority      = priority;
+			_group->weight = weight ? weight : (unsigned)DEFAULT_WEIGHT;
+		}
+
+		/**
+		 * Share the weight of 'group' with its other contexts
+		 *
+		 * Must be called before the context is submitted.
+		 */
+		void group(Weight_group &group)
+		{
+			_group->members--;
+			_group = &group;
+			_group->members++;
+		}
+
+		Weight_group       &group()       { return *_group; }
+		Weight_group const &group() const { return *_group; }
+
+		unsigned priority() const { return _priority; }
+
+		/**
+		 * Weight of the context, its share of the group's weight
+		 */
+		unsigned weight() const
+		{
+			unsigned const weight = _group->weight / _group->members;
+			return weight ? weight : 1;
+		}
+
+		/**
+		 * Account GPU time up to context timestamp 'timestamp'
+		 *
+		 * A timestamp older than the one accounted last, e.g., from a stale
+		 * context image, is not charged.
+		 *
+		 * \return  ticks consumed since the last call
+		 */
+		Genode::uint32_t account(Genode::uint32_t timestamp)
+		{
+			Genode::int32_t const delta = timestamp - _timestamp;
+			if (delta <= 0)
+				return 0;
+
+			_timestamp = timestamp;
+			_runtime  += delta;
+			return delta;
+		}
+
+		/**
+		 * Context timestamp saved in the context image
+		 */
+		Genode::uint32_t context_timestamp() { return _ctx->timestamp(); }
+
+		Genode::uint64_t runtime() const { return _runtime; }
+
+		Genode::uint64_t vruntime() const { return _vruntime; }
+		void vruntime(Genode::uint64_t vruntime) { _vruntime = vruntime; }
+
 		void info()
 		{
 			Genode::log ("Context info");
 			Genode::log ("   head_offset=", _ctx->head_offset ());
+			Genode::log ("   tail_offset=", _ring.published ());
 		};
 };
 
@@ -0,0 +1,160 @@
+/*
+ * \brief  Platform service without devices for the simulated IGD
+ * \author Alexander Senier
+ * \date   2017-01-30
+ */
+
+/*
+ * The service hands out DMA buffers as plain RAM dataspaces, so the GPU
+ * driver and the simulated IGD can run on base-linux. Buffers are accounted
+ * to the session quota like with the x86 platform driver. There are no
+ * devices.
+ */
+
+#include <base/component.h>
+#include <base/heap.h>
+#include <base/log.h>
+#include <dataspace/client.h>
+#include <platform_session/platform_session.h>
+#include <root/component.h>
+#include <util/arg_string.h>
+#include <util/list.h>
+
+namespace Platform {
+
+	class Session_component;
+	class Root;
+}
+
+class Platform::Session_component : public Genode::Rpc_object<Platform::Session>
+{
+	private:
+
+		struct Buffer : Genode::List<Buffer>::Element
+		{
+			Genode::Ram_dataspace_capability const ds;
+			Genode::size_t                   const size;
+
+			Buffer(Genode::Ram_dataspace_capability ds, Genode::size_t size)
+			: ds (ds), size (size) { }
+		};
+
+		Genode::Env          &_env;
+		Genode::Allocator    &_md_alloc;
+		Genode::size_t        _ram_quota;
+		Genode::size_t        _consumed = 0;
+		Genode::List<Buffer>  _buffers;
+
+		void _free(Buffer &b)
+		{
+			_buffers.remove (&b);
+			_env.ram().free (b.ds);
+			_consumed -= b.size + sizeof(Buffer);
+			Genode::destroy (&_md_alloc, &b);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param ram_quota  quota available for buffers and their metadata
+		 */
+		Session_component(Genode::Env &env, Genode::Allocator &md_alloc,
+		                  Genode::size_t ram_quota)
+		: _env (env), _md_alloc (md_alloc), _ram_quota (ram_quota) { }
+
+		~Session_component()
+		{
+			while (Buffer *b = _buffers.first())
+				_free (*b);
+		}
+
+		void upgrade(Genode::size_t ram_quota) { _ram_quota += ram_quota; }
+
+
+		/********************************
+		 ** Platform session interface **
+		 ********************************/
+
+		Device_capability first_device(unsigned, unsigned) override {
+			return Device_capability(); }
+
+		Device_capability next_device(Device_capability, unsigned, unsigned) override {
+			return Device_capability(); }
+
+		void release_device(Device_capability) override { }
+
+		Device_capability device(String const &) override {
+			return Device_capability(); }
+
+		Genode::Ram_dataspace_capability alloc_dma_buffer(Genode::size_t size) override
+		{
+			size = Genode::align_addr (size, 12);
+
+			if (_consumed + size + sizeof(Buffer) > _ram_quota)
+				throw Out_of_metadata();
+
+			Genode::Ram_dataspace_capability ds = _env.ram().alloc (size, Genode::UNCACHED);
+
+			_buffers.insert (new (&_md_alloc) Buffer (ds, size));
+			_consumed += size + sizeof(Buffer);
+			return ds;
+		}
+
+		void free_dma_buffer(Genode::Ram_dataspace_capability ds) override
+		{
+			for (Buffer *b = _buffers.first(); b; b = b->next())
+				if (b->ds == ds) {
+					_free (*b);
+					return;
+				}
+		}
+};
+
+class Platform::Root : public Genode::Root_component<Session_component>
+{
+	private:
+
+		Genode::Env &_env;
+
+		static Genode::size_t _ram_quota(char const *args) {
+			return Genode::Arg_string::find_arg (args, "ram_quota").ulong_value (0); }
+
+	protected:
+
+		Session_component *_create_session(char const *args) override
+		{
+			Genode::size_t const ram_quota = _ram_quota (args);
+
+			if (ram_quota < sizeof(Session_component))
+				throw Genode::Root::Quota_exceeded();
+
+			return new (md_alloc())
+				Session_component (_env, *md_alloc(), ram_quota - sizeof(Session_component));
+		}
+
+		void _upgrade_session(Session_component *session, char const *args) override
+		{
+			session->upgrade (_ram_quota (args));
+		}
+
+	public:
+
+		Root(Genode::Env &env, Genode::Allocator &md_alloc)
+		:
+			Genode::Root_component<Session_component> (env.ep(), md_alloc),
+			_env (env)
+		{ }
+};
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+void Component::construct(Genode::Env &env)
+{
+	static Genode::Sliced_heap sliced_heap (env.ram(), env.rm());
+	static Platform::Root      root (env, sliced_heap);
+
+	env.parent().announce (env.ep().manage (root));
+	Genode::log ("Simulated platform driver");
+}
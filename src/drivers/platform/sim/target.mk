@@ -0,0 +1,3 @@
+TARGET = sim_platform_drv
+SRC_CC = main.cc
+LIBS   = base
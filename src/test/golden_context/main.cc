@@ -0,0 +1,109 @@
+/*
+ * \brief  Compare golden context images with field-wise constructed contexts
+ * \author Alexander Senier
+ * \date   2017-01-27
+ */
+
+#include <base/component.h>
+#include <base/log.h>
+#include <util/construct_at.h>
+#include <util/string.h>
+
+#include <context.h>
+
+using namespace Genode;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+/* The golden images are built by the compiler */
+static constexpr Ring_context::Image rcs_ring = Ring_context::golden(ring_base(RCS));
+static_assert(rcs_ring.load_register_immediate_header == 0x1100101b, "Bad LRI header");
+static_assert(rcs_ring.registers[0] == ((0x2000ULL + 0x244) << 32 | 0xb), "Bad context control");
+
+enum { MAX_SIZE = Engine_context<RCS>::SIZE };
+
+static uint8_t reference_mem[MAX_SIZE] __attribute__((aligned(4096)));
+static uint8_t golden_mem[MAX_SIZE]    __attribute__((aligned(4096)));
+
+struct Params
+{
+	addr_t   ring;
+	size_t   ring_len;
+	uint64_t pdp0;
+};
+
+/* PDP0 has bit 31 set, which does not fit the PDP descriptor */
+static Params const first  = { 0x12345000, 0x3000,   0xabcdef000ULL };
+static Params const second = { 0x7f000000, 0x100000, 0x80001000ULL  };
+
+/*
+ * Build context of 'ENGINE' via the constructors taking all fields
+ */
+template <Engine ENGINE>
+static void construct_reference(Params const &p)
+{
+	typedef typename Context_layout<ENGINE>::Misc_context Misc_context;
+
+	memset(reference_mem, 0, sizeof(reference_mem));
+	construct_at<Execlist_context>(reference_mem, ring_base(ENGINE), p.ring,
+	                               p.ring_len, p.pdp0, 0, 0, 0, 0);
+	construct_at<Misc_context>(reference_mem + sizeof(Execlist_context));
+}
+
+static bool compare(char const *engine, char const *what, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (reference_mem[i] == golden_mem[i])
+			continue;
+
+		error("FAILED: ", engine, " ", what, ": byte ", Hex(i), " is ",
+		      Hex(golden_mem[i]), ", expected ", Hex(reference_mem[i]));
+		return false;
+	}
+	return true;
+}
+
+template <Engine ENGINE>
+static bool check(char const *engine)
+{
+	typedef Engine_context<ENGINE> Context;
+
+	bool ok = true;
+
+	/* Garbage must be overwritten by a new context */
+	memset(golden_mem, 0xa5, sizeof(golden_mem));
+	Context *context = construct_at<Context>(golden_mem, first.ring,
+	                                         first.ring_len, first.pdp0);
+	construct_reference<ENGINE>(first);
+	ok &= compare(engine, "new context", Context::SIZE);
+
+	/* A used context gets the state of a new one */
+	context->tail_offset(0x100);
+	context->reinit(second.ring, second.ring_len, second.pdp0);
+	construct_reference<ENGINE>(second);
+	ok &= compare(engine, "reinitialized context", Context::SIZE);
+
+	return ok;
+}
+
+void Component::construct(Genode::Env &env)
+{
+	bool ok = true;
+
+	log ("Golden context test");
+
+	ok &= check<RCS>  ("RCS");
+	ok &= check<BCS>  ("BCS");
+	ok &= check<VCS0> ("VCS0");
+	ok &= check<VCS1> ("VCS1");
+	ok &= check<VECS> ("VECS");
+
+	if (!ok) {
+		error ("Golden context test failed");
+		env.parent().exit(-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit(0);
+}
@@ -0,0 +1,6 @@
+TARGET = golden_context
+SRC_CC = main.cc
+LIBS   = base
+
+# For context.h
+INC_DIR += $(PRG_DIR)/../../app/hello_gpu
@@ -0,0 +1,386 @@
+/*
+ * \brief  Benchmark of the submission path against the simulated IGD
+ * \author Alexander Senier
+ * \date   2017-01-31
+ */
+
+/*
+ * Every result is logged as one XML node, so results can be extracted
+ * from the log and compared across releases:
+ *
+ * <result name="submit" unit="ticks" samples="1024" p50="..." .../>
+ *
+ * Times are measured in timestamp counter ticks. The 'calibration' result
+ * states the tick rate, which is also used for the rates reported.
+ *
+ * As the GPU is simulated, the numbers cover the driver's share of the
+ * submission path, i.e., building, inserting and committing jobs, writing
+ * the execlist port, and processing context status events and fences.
+ */
+
+#include <base/component.h>
+#include <base/heap.h>
+#include <base/log.h>
+#include <base/trace/timestamp.h>
+#include <platform_session/connection.h>
+#include <timer_session/connection.h>
+
+#include <igd.h>
+#include <sim_igd.h>
+#include <gpu_allocator.h>
+#include <quota.h>
+#include <context_pool.h>
+#include <submission.h>
+#include <scheduler.h>
+#include <batch_pool.h>
+#include <event_trace.h>
+
+using namespace Genode;
+
+typedef Trace::Timestamp Timestamp;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+enum {
+	SAMPLES    = 1024,
+	BATCHES    = 4096,
+	MAX_DEPTH  = 64,
+	RING_SLOTS = 2 * MAX_DEPTH,
+	MAPPINGS   = 64,
+
+	BATCH_GA   = 0xba7c4000,
+	MAP_GA     = 0x40000000,
+
+	HUGE_2M_LOG2 = 21,
+	HUGE_2M      = 1UL << HUGE_2M_LOG2,
+};
+
+static Timestamp samples[SAMPLES];
+
+/*
+ * Shell sort, the samples are sorted once per result
+ */
+static void sort(Timestamp *v, unsigned n)
+{
+	for (unsigned gap = n / 2; gap; gap /= 2)
+		for (unsigned i = gap; i < n; i++)
+			for (unsigned j = i; j >= gap && v[j - gap] > v[j]; j -= gap) {
+				Timestamp const t = v[j];
+				v[j] = v[j - gap];
+				v[j - gap] = t;
+			}
+}
+
+static void report_percentiles(char const *name, Timestamp *v, unsigned n)
+{
+	sort (v, n);
+
+	log ("<result name=\"", name, "\" unit=\"ticks\" samples=\"", n, "\""
+	     " p50=\"", v[n / 2], "\""
+	     " p90=\"", v[n * 9 / 10], "\""
+	     " p99=\"", v[n * 99 / 100], "\""
+	     " max=\"", v[n - 1], "\"/>");
+}
+
+struct Bench
+{
+	Env &env;
+
+	Heap              heap  { env.ram(), env.rm() };
+	Timer::Connection timer { env };
+
+	/* BAR0 of the simulated IGD is plain memory */
+	Ram_dataspace_capability const bar_ds = env.ram().alloc (Sim_igd::BAR_SIZE);
+	addr_t                   const bar    = env.rm().attach (bar_ds);
+
+	Platform::Connection pci           { env };
+	Quota_manager        quota         { env, pci.cap(), 16*1024*1024 };
+	GPU_allocator        gpu_allocator { env, pci, quota, GPU_allocator::POOL };
+
+	IGD     igd { env, bar };
+	Sim_igd sim { gpu_allocator, bar };
+
+	Execlist_scheduler *scheduler[NUM_ENGINES];
+
+	Context_pool context_pool { gpu_allocator, heap };
+
+	/* Ticks per millisecond */
+	Timestamp rate = 0;
+
+	/*
+	 * Run engines until no more work is submitted
+	 */
+	void drain()
+	{
+		do
+			for (Execlist_scheduler *s : scheduler)
+				s->process ([] (Context_status_buffer::Event const &) { });
+		while (sim.step());
+	}
+
+	/*
+	 * Empty batch of 'pool', fails the benchmark if none is available
+	 */
+	Batch &noop_batch(Batch_pool &pool)
+	{
+		Batch *batch = pool.alloc();
+		if (!batch) {
+			error ("no batch available");
+			throw -1;
+		}
+
+		batch->emit (Mi_noop());
+		return *batch;
+	}
+
+	/*
+	 * Insert 'batch' into the ring, fails the benchmark if it is full
+	 */
+	void submit(Batch_pool &pool, Batch &batch)
+	{
+		if (!pool.submit (batch)) {
+			error ("submission ring full");
+			throw -1;
+		}
+	}
+
+	/*
+	 * Submit batch of 'pool' and run it to completion
+	 *
+	 * \return  ticks from insertion to the fence being signaled
+	 */
+	Timestamp roundtrip(Submission &s, Batch_pool &pool)
+	{
+		Batch &batch = noop_batch (pool);
+
+		Timestamp const start = Trace::timestamp();
+		submit (pool, batch);
+		scheduler[s.engine()]->submit (s);
+		drain();
+
+		return Trace::timestamp() - start;
+	}
+
+	Timestamp per_second(unsigned long count, Timestamp ticks) {
+		return ticks ? count * rate * 1000 / ticks : 0; }
+
+	void calibrate()
+	{
+		unsigned long const ms    = timer.elapsed_ms();
+		Timestamp     const start = Trace::timestamp();
+
+		timer.msleep (100);
+
+		unsigned long const elapsed = timer.elapsed_ms() - ms;
+		rate = (Trace::timestamp() - start) / (elapsed ? elapsed : 1);
+
+		log ("<result name=\"calibration\" unit=\"ticks_per_ms\" value=\"", rate, "\"/>");
+	}
+
+	/*
+	 * Latency of single batches from insertion to the execlist port and
+	 * to completion
+	 */
+	void latency()
+	{
+		Submission s (&gpu_allocator, context_pool, igd, RCS, RING_SLOTS, 1);
+		Batch_pool pool (gpu_allocator, heap, s, BATCH_GA, 1);
+
+		static Timestamp complete[SAMPLES];
+
+		for (unsigned i = 0; i < SAMPLES; i++) {
+
+			Batch &batch = noop_batch (pool);
+
+			Timestamp const start = Trace::timestamp();
+			submit (pool, batch);
+			scheduler[RCS]->submit (s);
+			Timestamp const submitted = Trace::timestamp();
+			drain();
+
+			samples[i]  = submitted - start;
+			complete[i] = Trace::timestamp() - start;
+		}
+
+		report_percentiles ("submit",     samples,  SAMPLES);
+		report_percentiles ("completion", complete, SAMPLES);
+	}
+
+	/*
+	 * Batches per second with 'depth' batches committed at once
+	 */
+	void throughput(unsigned depth)
+	{
+		Submission s (&gpu_allocator, context_pool, igd, RCS, RING_SLOTS, 1);
+		Batch_pool pool (gpu_allocator, heap, s, BATCH_GA, depth);
+
+		Timestamp const start = Trace::timestamp();
+
+		for (unsigned done = 0; done < BATCHES; done += depth) {
+
+			for (unsigned i = 0; i < depth; i++)
+				submit (pool, noop_batch (pool));
+
+			scheduler[RCS]->submit (s);
+			drain();
+		}
+
+		Timestamp const ticks = Trace::timestamp() - start;
+
+		log ("<result name=\"throughput\" depth=\"", depth, "\" batches=\"", (unsigned)BATCHES, "\""
+		     " ticks_per_batch=\"", ticks / BATCHES, "\""
+		     " batches_per_s=\"", per_second (BATCHES, ticks), "\"/>");
+	}
+
+	/*
+	 * Cost of switching contexts compared to resubmitting the same one
+	 */
+	void context_switch()
+	{
+		Submission a (&gpu_allocator, context_pool, igd, RCS, RING_SLOTS, 1);
+		Submission b (&gpu_allocator, context_pool, igd, RCS, RING_SLOTS, 2);
+		Batch_pool pool_a (gpu_allocator, heap, a, BATCH_GA, 1);
+		Batch_pool pool_b (gpu_allocator, heap, b, BATCH_GA, 1);
+
+		Timestamp same = 0, alternating = 0;
+
+		for (unsigned i = 0; i < SAMPLES; i++)
+			same += roundtrip (a, pool_a);
+
+		for (unsigned i = 0; i < SAMPLES; i++)
+			alternating += (i & 1) ? roundtrip (b, pool_b) : roundtrip (a, pool_a);
+
+		same        /= SAMPLES;
+		alternating /= SAMPLES;
+
+		log ("<result name=\"context_switch\" unit=\"ticks\""
+		     " same=\"", same, "\" alternating=\"", alternating, "\""
+		     " switch=\"", alternating > same ? alternating - same : 0, "\"/>");
+	}
+
+	/*
+	 * Mapping throughput of a 2 MiB range by 4 KiB pages and one 2 MiB page
+	 */
+	void mapping()
+	{
+		Submission s (&gpu_allocator, context_pool, igd, RCS, RING_SLOTS, 1);
+
+		Page_flags const flags = Page_flags
+			{ .writeable  = true,
+			  .executable = false,
+			  .privileged = false,
+			  .global     = false,
+			  .device     = false,
+			  .cacheable  = UNCACHED };
+
+		/* The buffer contains an aligned 2 MiB page */
+		void *buffer;
+		if (!gpu_allocator.alloc (2 * HUGE_2M, &buffer))
+			throw -1;
+		addr_t const pa = align_addr ((addr_t)gpu_allocator.phys_addr (buffer), HUGE_2M_LOG2);
+
+		Timestamp start = Trace::timestamp();
+		for (unsigned r = 0; r < MAPPINGS; r++) {
+			for (addr_t off = 0; off < HUGE_2M; off += 4096)
+				s.insert_translation (MAP_GA + off, pa + off, 4096, flags);
+			s.remove_translation (MAP_GA, HUGE_2M);
+		}
+		Timestamp const small = Trace::timestamp() - start;
+
+		start = Trace::timestamp();
+		for (unsigned r = 0; r < MAPPINGS; r++) {
+			s.insert_translation (MAP_GA, pa, HUGE_2M, flags);
+			s.remove_translation (MAP_GA, HUGE_2M);
+		}
+		Timestamp const huge = Trace::timestamp() - start;
+
+		unsigned long const mib = MAPPINGS * HUGE_2M / (1024 * 1024);
+
+		log ("<result name=\"mapping\" page=\"4K\" ticks_per_page=\"", small / (MAPPINGS * (HUGE_2M / 4096)), "\""
+		     " mib_per_s=\"", per_second (mib, small), "\"/>");
+		log ("<result name=\"mapping\" page=\"2M\" ticks_per_page=\"", huge / MAPPINGS, "\""
+		     " mib_per_s=\"", per_second (mib, huge), "\"/>");
+
+		gpu_allocator.free (buffer, 2 * HUGE_2M);
+	}
+
+	/*
+	 * Cost of an enabled and a disabled trace point
+	 */
+	void trace_point()
+	{
+		enum { RECORDS = 16 * Event_trace::CAPACITY };
+
+		Event_trace &trace = event_trace();
+		Timestamp ticks[2];
+
+		for (unsigned enabled = 0; enabled < 2; enabled++) {
+
+			trace.enabled (enabled);
+
+			Timestamp const start = Trace::timestamp();
+			for (unsigned i = 0; i < RECORDS; i++)
+				trace.record (Event_trace::RING_INSERT, RCS, 1, i);
+			ticks[enabled] = (Trace::timestamp() - start) / RECORDS;
+		}
+
+		trace.enabled (false);
+
+		log ("<result name=\"trace_point\" unit=\"ticks\""
+		     " disabled=\"", ticks[0], "\" enabled=\"", ticks[1], "\""
+		     " enabled_ns=\"", rate ? ticks[1] * 1000000 / rate : 0, "\"/>");
+	}
+
+	Bench(Env &env) : env (env)
+	{
+		igd.engine_model (sim);
+
+		for (unsigned i = 0; i < NUM_ENGINES; i++) {
+
+			Engine const e = (Engine)i;
+
+			uint32_t *hwsp;
+			if (!gpu_allocator.alloc (4096, (void **)&hwsp))
+				throw -1;
+
+			memset (hwsp, 0, 4096);
+			igd.setup_engine (e, (addr_t)gpu_allocator.phys_addr (hwsp));
+
+			Context_status_buffer *csb = new (heap) Context_status_buffer (hwsp);
+			scheduler[e] = new (heap) Execlist_scheduler (igd, e, *csb);
+		}
+	}
+};
+
+void Component::construct(Genode::Env &env)
+{
+	log ("Submission benchmark");
+
+	static Bench bench (env);
+
+	try {
+		bench.calibrate();
+		bench.latency();
+
+		static unsigned const depths[] = { 1, 4, 16, MAX_DEPTH };
+		for (unsigned depth : depths)
+			bench.throughput (depth);
+
+		bench.context_switch();
+		bench.mapping();
+		bench.trace_point();
+	} catch (int) {
+		error ("benchmark failed");
+		env.parent().exit (-1);
+		return;
+	}
+
+	if (bench.sim.faults()) {
+		error ("simulated IGD faulted ", bench.sim.faults(), " times");
+		env.parent().exit (-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit (0);
+}
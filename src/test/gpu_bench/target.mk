@@ -0,0 +1,6 @@
+TARGET = gpu_bench
+SRC_CC = main.cc
+LIBS   = base
+
+# For the driver headers
+INC_DIR += $(PRG_DIR)/../../app/hello_gpu
@@ -0,0 +1,110 @@
+/*
+ * \brief  Exercise the GPU session interface
+ * \author Alexander Senier
+ * \date   2017-01-25
+ */
+
+#include <base/component.h>
+#include <base/log.h>
+#include <base/signal.h>
+#include <gpu_session/connection.h>
+#include <test/check.h>
+
+using namespace Genode;
+using Test::check;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+enum {
+	BATCH_GA   = 0x100000,
+	BUFFER_GA  = 0x200000,
+	BATCHES    = 64,
+
+	/* MI_BATCH_BUFFER_END followed by MI_NOOP */
+	MI_BATCH_BUFFER_END = 0x05000000,
+};
+
+template <typename EXC, typename FUNC>
+static bool throws(FUNC const &fn)
+{
+	try { fn(); } catch (EXC) { return true; }
+	return false;
+}
+
+struct Main
+{
+	Env &env;
+
+	Gpu::Connection gpu { env };
+
+	Signal_handler<Main> completion_handler { env.ep(), *this, &Main::handle_completion };
+
+	Ram_dataspace_capability batch_ds  = gpu.alloc_buffer(4096);
+	Ram_dataspace_capability buffer_ds = gpu.alloc_buffer(1024*1024);
+
+	uint32_t *batch = env.rm().attach(batch_ds);
+
+	Gpu::Session::Seqno last = 0;
+	bool ok   = true;
+	bool done = false;
+
+	void finish()
+	{
+		done = true;
+		env.rm().detach(batch);
+		gpu.free_buffer(batch_ds);
+		gpu.free_buffer(buffer_ds);
+
+		log(ok ? "Test succeeded" : "Test failed");
+		env.parent().exit(ok ? 0 : 1);
+	}
+
+	void handle_completion()
+	{
+		if (!done && (int32_t)(gpu.completed() - last) >= 0)
+			finish();
+	}
+
+	Main(Env &env) : env(env)
+	{
+		log("GPU session test");
+
+		*batch = MI_BATCH_BUFFER_END;
+
+		gpu.map_buffer(batch_ds,  BATCH_GA,  false);
+		gpu.map_buffer(buffer_ds, BUFFER_GA, true);
+
+		ok &= check(throws<Gpu::Session::Invalid_buffer>([&] () {
+			gpu.map_buffer(batch_ds, BATCH_GA + 0x10000, false); }),
+			"mapping buffer twice");
+
+		ok &= check(throws<Gpu::Session::Invalid_buffer>([&] () {
+			gpu.unmap_buffer(buffer_ds);
+			gpu.map_buffer(buffer_ds, BATCH_GA - 0x1000, true); }),
+			"mapping overlapping range");
+
+		ok &= check(throws<Gpu::Session::Invalid_buffer>([&] () {
+			gpu.map_buffer(buffer_ds, 0, true); }),
+			"mapping reserved range");
+
+		gpu.map_buffer(buffer_ds, BUFFER_GA, true);
+
+		ok &= check(throws<Gpu::Session::Invalid_buffer>([&] () {
+			gpu.exec_buffer(BATCH_GA + 0x1000); }),
+			"executing unmapped address");
+
+		gpu.completion_sigh(completion_handler);
+
+		Gpu::Session::Seqno first = 0;
+		for (unsigned i = 0; i < BATCHES; i++) {
+			Gpu::Session::Seqno const seqno = gpu.exec_buffer(BATCH_GA);
+			if (i == 0)
+				first = seqno;
+			last = seqno;
+		}
+
+		ok &= check(last - first == BATCHES - 1, "sequence numbers in order");
+	}
+};
+
+void Component::construct(Genode::Env &env) { static Main main(env); }
@@ -0,0 +1,3 @@
+TARGET = gpu_session
+SRC_CC = main.cc
+LIBS   = base
@@ -0,0 +1,176 @@
+/*
+ * \brief  Decode and aggregate synthetic OA report buffers
+ * \author Alexander Senier
+ * \date   2017-02-03
+ */
+
+/*
+ * All reports are synthetic, composed by the test after the documented
+ * Gen8 report layout, so the test runs without an IGD and does not cover
+ * the hardware. The reports cover a wrap of the ring, a wrap of 40 and 32
+ * bit counters, and a second context in between the reports of the first
+ * one. Reports of real hardware are logged by the driver's OA sampler with
+ * 'dump' set, as eight hex dwords per line.
+ */
+
+#include <base/component.h>
+#include <base/log.h>
+#include <test/check.h>
+
+#include <oa.h>
+
+using namespace Genode;
+using Test::check;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+enum {
+	SLOTS   = 8,
+	REPORTS = 12,
+
+	CONTEXT_A = 0x1000,
+	CONTEXT_B = 0x2005,
+	CONTEXT_MASK = 0xfffff000,
+
+	A40_START = 0xfffffffe00ULL,
+};
+
+/*
+ * Synthetic timer report following the layout of the A32u40_A4u32_B8_C8
+ * format
+ */
+static uint32_t const synthetic[Oa_report::SIZE / 4] = {
+	0x00080001, 0x00001000, 0x12345000, 0x00000200,
+	0xdeadbeef, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000077, 0x00000000, 0x00000000, 0x00000000,
+	0x00000012, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x000000b0, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x00000000,
+	0x00000000, 0x00000000, 0x00000000, 0x000000c7 };
+
+static uint32_t buffer[SLOTS * Oa_report::SIZE / 4];
+
+/*
+ * Compose synthetic report 'n' in 'slot'
+ *
+ * Reports 4 to 6 belong to context B, all others to context A.
+ */
+static void write_report(unsigned slot, unsigned n)
+{
+	uint32_t *dw = buffer + slot * Oa_report::SIZE / 4;
+	memset (dw, 0, Oa_report::SIZE);
+
+	uint64_t const a0 = (A40_START + n * 0x100) & 0xffffffffffULL;
+
+	dw[0]  = Oa_report::Header::Reason::bits (Oa_report::Header::Reason::TIMER);
+	dw[1]  = 0xffffff00 + n * 100;
+	dw[2]  = (n >= 4 && n <= 6) ? CONTEXT_B : CONTEXT_A;
+	dw[3]  = n * 90;
+	dw[4]  = (uint32_t)a0;
+	dw[40] = (uint32_t)(a0 >> 32);
+	dw[36] = 0xffffff00 + n * 0x40;
+	dw[48] = n;
+	dw[56] = 2 * n;
+}
+
+/*
+ * Write synthetic reports into the ring and consume them in two rounds,
+ * the second one wrapping around the end of the ring
+ */
+static void write_and_consume(Oa_buffer &reports)
+{
+	enum { SIZE = Oa_report::SIZE };
+
+	memset (buffer, 0, sizeof(buffer));
+
+	for (unsigned n = 0; n < 6; n++)
+		write_report (n, n);
+
+	size_t head = reports.consume (0, 6 * SIZE);
+
+	for (unsigned n = 6; n < REPORTS; n++)
+		write_report (n % SLOTS, n);
+
+	reports.consume (head, (REPORTS % SLOTS) * SIZE);
+}
+
+void Component::construct(Genode::Env &env)
+{
+	log ("OA report test");
+
+	bool ok = true;
+
+	/* Decoding */
+	Oa_report const r (synthetic);
+
+	ok &= check (r.valid(),                                         "synthetic report valid");
+	ok &= check (r.reason() == Oa_report::Header::Reason::TIMER,    "report reason");
+	ok &= check (r.timestamp()  == 0x1000,                          "timestamp");
+	ok &= check (r.context_id() == 0x12345000,                      "context ID");
+	ok &= check (r.gpu_ticks()  == 0x200,                           "GPU ticks");
+	ok &= check (r.a(0)  == 0x12deadbeefULL,                        "40 bit A counter");
+	ok &= check (r.a(1)  == 0,                                      "high byte of A1");
+	ok &= check (r.a(32) == 0x77,                                   "32 bit A counter");
+	ok &= check (r.b(0)  == 0xb0 && r.c(7) == 0xc7,                 "B and C counters");
+
+	uint32_t const zero[Oa_report::SIZE / 4] = { };
+	ok &= check (!Oa_report (zero).valid(),                         "zeroed slot invalid");
+
+	/* Aggregation of all reports */
+	Oa_buffer all (buffer, sizeof(buffer));
+	write_and_consume (all);
+
+	Oa_counters const &c = all.counters();
+	unsigned const deltas = REPORTS - 1;
+
+	ok &= check (all.reports() == REPORTS && all.filtered() == 0,   "all reports consumed");
+	ok &= check (c.deltas()    == deltas,                           "deltas");
+	ok &= check (c.a(0)  == deltas * 0x100,                         "40 bit counter wrap");
+	ok &= check (c.a(32) == deltas * 0x40,                          "32 bit counter wrap");
+	ok &= check (c.b(0)  == deltas && c.c(0) == 2 * deltas,         "B and C deltas");
+	ok &= check (c.timestamp() == deltas * 100,                     "timestamp wrap");
+	ok &= check (c.gpu_ticks() == deltas * 90,                      "GPU tick deltas");
+	ok &= check (all.invalid() == 0,                                "no invalid reports");
+	ok &= check (!Oa_report (buffer).valid(),                       "consumed slots zeroed");
+
+	/* A zeroed slot breaks the chain of deltas */
+	write_report (5, REPORTS);
+	all.consume (4 * Oa_report::SIZE, 6 * Oa_report::SIZE);
+	ok &= check (all.invalid() == 1 && c.deltas() == deltas,        "no delta across lost report");
+
+	/* Deltas of context A start at reports 0 to 3 and 7 to 10 */
+	Oa_buffer a (buffer, sizeof(buffer));
+	a.filter (CONTEXT_A, CONTEXT_MASK);
+	write_and_consume (a);
+
+	ok &= check (a.counters().deltas() == 8 && a.filtered() == 3,   "deltas of context A");
+	ok &= check (a.counters().a(0) == 8 * 0x100,                    "counters of context A");
+
+	/* The lower bits of the ID of context B are masked */
+	Oa_buffer b (buffer, sizeof(buffer));
+	b.filter (CONTEXT_B & CONTEXT_MASK, CONTEXT_MASK);
+	write_and_consume (b);
+
+	ok &= check (b.counters().deltas() == 3 && b.filtered() == 8,   "deltas of context B");
+	ok &= check (b.counters().b(0) == 3,                            "counters of context B");
+
+	log ("reports=", all.reports(), " deltas=", c.deltas(),
+	     " context A=", a.counters().deltas(), " context B=", b.counters().deltas());
+
+	if (!ok) {
+		env.parent().exit (-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit (0);
+}
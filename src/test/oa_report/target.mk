@@ -0,0 +1,6 @@
+TARGET = oa_report
+SRC_CC = main.cc
+LIBS   = base
+
+# For the driver headers
+INC_DIR += $(PRG_DIR)/../../app/hello_gpu
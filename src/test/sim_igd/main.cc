@@ -0,0 +1,169 @@
+/*
+ * \brief  Run IGD, Submission and GPU_allocator against the simulated IGD
+ * \author Alexander Senier
+ * \date   2017-01-30
+ */
+
+#include <base/component.h>
+#include <base/heap.h>
+#include <base/log.h>
+#include <platform_session/connection.h>
+#include <test/check.h>
+
+#include <igd.h>
+#include <sim_igd.h>
+#include <gpu_allocator.h>
+#include <quota.h>
+#include <context_pool.h>
+#include <submission.h>
+#include <scheduler.h>
+#include <batch_pool.h>
+
+using namespace Genode;
+using Test::check;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+enum {
+	TARGET_GA = 0x10000000,
+	BATCH_GA  = 0xba7c4000,
+
+	/* Stores of the large batch, spanning several batch pages */
+	STORES    = 1000,
+};
+
+void Component::construct(Genode::Env &env)
+{
+	log ("Simulated IGD test");
+
+	static Heap heap (env.ram(), env.rm());
+
+	Event_trace &trace = event_trace();
+	trace.enabled (true);
+
+	/* BAR0 of the simulated IGD is plain memory */
+	Ram_dataspace_capability bar_ds = env.ram().alloc (Sim_igd::BAR_SIZE);
+	addr_t const bar = env.rm().attach (bar_ds);
+
+	static Platform::Connection pci (env);
+	static Quota_manager        quota (env, pci.cap(), 4*1024*1024);
+	static GPU_allocator        gpu_allocator (env, pci, quota, GPU_allocator::POOL);
+
+	static IGD     igd (env, bar);
+	static Sim_igd sim (gpu_allocator, bar);
+	igd.engine_model (sim);
+
+	static Execlist_scheduler *scheduler[NUM_ENGINES];
+	for (unsigned i = 0; i < NUM_ENGINES; i++)
+	{
+		Engine const e = (Engine)i;
+
+		uint32_t *hwsp;
+		if (!gpu_allocator.alloc (4096, (void **)&hwsp))
+			throw -1;
+
+		memset (hwsp, 0, 4096);
+		igd.setup_engine (e, (addr_t)gpu_allocator.phys_addr (hwsp));
+
+		Context_status_buffer *csb = new (heap) Context_status_buffer (hwsp);
+		scheduler[e] = new (heap) Execlist_scheduler (igd, e, *csb);
+	}
+
+	static Context_pool context_pool (gpu_allocator, heap);
+
+	/* Both render contexts share the execlist port */
+	static Submission first  (&gpu_allocator, context_pool, igd, RCS, 16, 1);
+	static Submission second (&gpu_allocator, context_pool, igd, RCS, 16, 2);
+	static Submission blit   (&gpu_allocator, context_pool, igd, BCS, 16, 3);
+
+	Submission *submissions[] = { &first, &second, &blit };
+
+	/* Target page mapped into every context */
+	uint32_t *target;
+	if (!gpu_allocator.alloc (4096, (void **)&target))
+		throw -1;
+	memset (target, 0, 4096);
+
+	Page_flags const flags = Page_flags
+		{ .writeable  = true,
+		  .executable = false,
+		  .privileged = true,
+		  .global     = false,
+		  .device     = false,
+		  .cacheable  = UNCACHED };
+
+	for (Submission *s : submissions)
+		s->insert_translation (TARGET_GA, (addr_t)gpu_allocator.phys_addr (target), 4096, flags);
+
+	int const ppgtt = Mi_store_data_imm::Header::Use_global_gtt::PPGTT;
+
+	Batch_pool *pools[3];
+	for (unsigned i = 0; i < 3; i++)
+		pools[i] = new (heap) Batch_pool (gpu_allocator, heap, *submissions[i], BATCH_GA, 2);
+
+	/* Large batch of the first context, chained across batch pages */
+	Batch *large = pools[0]->alloc();
+	for (unsigned i = 0; i < STORES; i++)
+		large->emit (Mi_store_data_imm (TARGET_GA + 4 * i, i + 1, ppgtt));
+
+	/* Single store by the other contexts behind the stores above */
+	Batch *marker[2] = { pools[1]->alloc(), pools[2]->alloc() };
+	marker[0]->emit (Mi_store_data_imm (TARGET_GA + 4 * STORES, 0xcafe, ppgtt));
+	marker[1]->emit (Mi_store_data_imm (TARGET_GA + 4 * (STORES + 1), 0xb1d, ppgtt));
+
+	bool ok = true;
+
+	ok &= check (pools[0]->submit (*large),     "submit large batch");
+	ok &= check (pools[1]->submit (*marker[0]), "submit marker of second context");
+	ok &= check (pools[2]->submit (*marker[1]), "submit marker of blitter context");
+
+	for (Submission *s : submissions)
+		scheduler[s->engine()]->submit (*s);
+
+	/* Drive the engines until no more work is submitted */
+	unsigned events = 0, empty = 0;
+	while (sim.step())
+		for (Execlist_scheduler *s : scheduler)
+			events += s->process ([&] (Context_status_buffer::Event const &e) {
+				if (!e.status()) empty++; });
+
+	bool stored = true;
+	for (unsigned i = 0; i < STORES; i++)
+		stored &= target[i] == i + 1;
+
+	ok &= check (stored,                                  "stores of chained batch");
+	ok &= check (large->pages() > 1,                      "batch spans several pages");
+	ok &= check (target[STORES]     == 0xcafe,            "store of second context");
+	ok &= check (target[STORES + 1] == 0xb1d,             "store of blitter context");
+	ok &= check (first.idle() && second.idle() && blit.idle(), "fences signaled");
+	ok &= check (sim.faults() == 0,                       "no translation faults");
+	ok &= check (first.runtime() >= STORES,               "runtime accounted");
+	ok &= check (empty == 0,                              "no stale CSB entries");
+	ok &= check (igd.invalidate_tlb (RCS),                "TLB invalidation completed");
+
+	for (Execlist_scheduler *s : scheduler)
+		ok &= check (!s->current(), "execlist port empty");
+
+	/* One job per submission, two contexts in the port of RCS */
+	ok &= check (trace.count (Event_trace::RING_INSERT) == 3,      "traced ring inserts");
+	ok &= check (trace.count (Event_trace::ELSP_WRITE)  >= 2,      "traced ELSP writes");
+	ok &= check (trace.count (Event_trace::CSB_EVENT)   == events, "traced CSB events");
+	ok &= check (trace.count (Event_trace::SEQNO)       == 3,      "traced completions");
+	ok &= check (trace.count (Event_trace::ALLOC)       >  0,      "traced allocations");
+	ok &= check (trace.count (Event_trace::FAULT)       == 0,      "no traced faults");
+
+	static char json[Event_trace::CAPACITY * 256];
+	size_t const json_len = trace.chrome_json (json, sizeof(json), 1000);
+	ok &= check (json_len > 16 && json[json_len - 1] == '}', "Chrome trace export");
+
+	log ("events=", events, " commands=", sim.commands(), " batches=", sim.batches(),
+	     " runtime=", first.runtime(), "/", second.runtime(), "/", blit.runtime());
+
+	if (!ok) {
+		env.parent().exit (-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit (0);
+}
@@ -0,0 +1,218 @@
+/*
+ * \brief  Execlist scheduler policies against the simulated IGD
+ * \author Alexander Senier
+ * \date   2017-02-06
+ */
+
+#include <base/component.h>
+#include <base/heap.h>
+#include <base/log.h>
+#include <platform_session/connection.h>
+#include <test/check.h>
+
+#include <igd.h>
+#include <sim_igd.h>
+#include <gpu_allocator.h>
+#include <quota.h>
+#include <context_pool.h>
+#include <submission.h>
+#include <scheduler.h>
+#include <batch_pool.h>
+
+using namespace Genode;
+using Test::check;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+enum {
+	TARGET_GA = 0x10000000,
+	BATCH_GA  = 0xba7c4000,
+
+	/* Stores of every batch */
+	STORES    = 64,
+
+	/* Contexts of each weight group, more than fit into the port */
+	MEMBERS   = 4,
+	ROUNDS    = 300,
+};
+
+/*
+ * Timer that only records whether the scheduler armed it
+ */
+struct Test_timer : Execlist_scheduler::Timeslice_timer
+{
+	bool armed = false;
+
+	void arm() override { armed = true; }
+};
+
+/*
+ * Render context with a pool of batches storing to the target page
+ */
+struct Client
+{
+	Submission submission;
+	Batch_pool pool;
+
+	Client(GPU_allocator &gpu_allocator, Context_pool &context_pool, IGD &igd,
+	       Allocator &heap, unsigned id, addr_t target_pa)
+	:
+		submission (&gpu_allocator, context_pool, igd, RCS, 16, id),
+		pool (gpu_allocator, heap, submission, BATCH_GA, 2)
+	{
+		Page_flags const flags = Page_flags
+			{ .writeable  = true,
+			  .executable = false,
+			  .privileged = true,
+			  .global     = false,
+			  .device     = false,
+			  .cacheable  = UNCACHED };
+
+		submission.insert_translation (TARGET_GA, target_pa, 4096, flags);
+	}
+
+	bool submit(Execlist_scheduler &scheduler, uint32_t value)
+	{
+		int const ppgtt = Mi_store_data_imm::Header::Use_global_gtt::PPGTT;
+
+		Batch *batch = pool.alloc();
+		if (!batch)
+			return false;
+
+		for (unsigned i = 0; i < STORES; i++)
+			batch->emit (Mi_store_data_imm (TARGET_GA + 4 * i, value, ppgtt));
+
+		if (!pool.submit (*batch)) {
+			pool.free (*batch);
+			return false;
+		}
+
+		scheduler.submit (submission);
+		return true;
+	}
+};
+
+void Component::construct(Genode::Env &env)
+{
+	log ("Simulated scheduler test");
+
+	static Heap heap (env.ram(), env.rm());
+
+	/* BAR0 of the simulated IGD is plain memory */
+	Ram_dataspace_capability bar_ds = env.ram().alloc (Sim_igd::BAR_SIZE);
+	addr_t const bar = env.rm().attach (bar_ds);
+
+	static Platform::Connection pci (env);
+	static Quota_manager        quota (env, pci.cap(), 8*1024*1024);
+	static GPU_allocator        gpu_allocator (env, pci, quota, GPU_allocator::POOL);
+
+	static IGD     igd (env, bar);
+	static Sim_igd sim (gpu_allocator, bar);
+	igd.engine_model (sim);
+
+	uint32_t *hwsp;
+	if (!gpu_allocator.alloc (4096, (void **)&hwsp))
+		throw -1;
+
+	memset (hwsp, 0, 4096);
+	igd.setup_engine (RCS, (addr_t)gpu_allocator.phys_addr (hwsp));
+
+	static Context_status_buffer csb (hwsp);
+	static Execlist_scheduler    scheduler (igd, RCS, csb);
+	static Test_timer            timer;
+	scheduler.timeslice_timer (timer);
+
+	static Context_pool context_pool (gpu_allocator, heap);
+
+	uint32_t *target;
+	if (!gpu_allocator.alloc (4096, (void **)&target))
+		throw -1;
+	memset (target, 0, 4096);
+
+	addr_t const target_pa = (addr_t)gpu_allocator.phys_addr (target);
+
+	/* Completion order of the contexts */
+	unsigned completed[8] = { };
+	unsigned completions  = 0;
+
+	auto drive = [&] () {
+		sim.step();
+		scheduler.process ([&] (Context_status_buffer::Event const &e) {
+			if (e.complete() && completions < 8)
+				completed[completions++] = e.context_id(); });
+	};
+
+	bool ok = true;
+
+	/*
+	 * A context of higher priority preempts element 0
+	 */
+	Client &low  = *new (heap) Client (gpu_allocator, context_pool, igd, heap, 1, target_pa);
+	Client &high = *new (heap) Client (gpu_allocator, context_pool, igd, heap, 2, target_pa);
+	high.submission.schedule (1, 0);
+
+	ok &= check (low.submit (scheduler, 1),           "submit low-priority batch");
+	ok &= check (scheduler.current() == &low.submission, "low priority in element 0");
+	ok &= check (!timer.armed,                        "timer unarmed without contention");
+
+	ok &= check (high.submit (scheduler, 2),          "submit high-priority batch");
+	ok &= check (scheduler.current() == &high.submission, "high priority in element 0");
+	ok &= check (scheduler.preemptions() == 1,        "element 0 preempted");
+	ok &= check (timer.armed,                         "timer armed on contention");
+
+	while (!scheduler.idle())
+		drive();
+
+	ok &= check (completions == 2 && completed[0] == 2 && completed[1] == 1,
+	             "high priority completed first");
+	ok &= check (target[0] == 1,                      "low-priority batch executed");
+
+	/*
+	 * Two weight groups split the runtime by their weights
+	 */
+	static Weight_group heavy (2 * Submission::DEFAULT_WEIGHT);
+	static Weight_group light (Submission::DEFAULT_WEIGHT);
+
+	Client *clients[2 * MEMBERS];
+	for (unsigned i = 0; i < 2 * MEMBERS; i++) {
+		clients[i] = new (heap) Client (gpu_allocator, context_pool, igd, heap,
+		                                3 + i, target_pa);
+		clients[i]->submission.group (i < MEMBERS ? heavy : light);
+	}
+
+	/* Keep every context busy, expire a timeslice after every step */
+	for (unsigned round = 0; round < ROUNDS; round++) {
+
+		for (Client *c : clients)
+			if (c->submission.idle() && !c->submit (scheduler, round))
+				ok &= check (false, "submit weighted batch");
+
+		timer.armed = false;
+		scheduler.timeslice();
+		drive();
+	}
+
+	while (!scheduler.idle())
+		drive();
+
+	uint64_t runtime[2] = { 0, 0 };
+	for (unsigned i = 0; i < 2 * MEMBERS; i++)
+		runtime[i / MEMBERS] += clients[i]->submission.runtime();
+
+	log ("runtime heavy=", runtime[0], " light=", runtime[1],
+	     " preemptions=", scheduler.preemptions());
+
+	/* Within 10 percent of the 2:1 split */
+	ok &= check (runtime[1] > 0,                            "light group ran");
+	ok &= check (runtime[0] * 10 >= runtime[1] * 18 &&
+	             runtime[0] * 10 <= runtime[1] * 22,        "runtime split by weight");
+	ok &= check (sim.faults() == 0,                         "no translation faults");
+
+	if (!ok) {
+		env.parent().exit (-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit (0);
+}
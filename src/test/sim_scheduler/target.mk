@@ -0,0 +1,7 @@
+TARGET   = sim_scheduler
+REQUIRES = linux
+SRC_CC   = main.cc
+LIBS     = base
+
+# For the driver headers
+INC_DIR += $(PRG_DIR)/../../app/hello_gpu
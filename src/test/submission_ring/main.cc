@@ -0,0 +1,135 @@
+/*
+ * \brief  Drive the submission ring against a simulated head pointer
+ * \author Alexander Senier
+ * \date   2017-01-11
+ */
+
+#include <base/component.h>
+#include <base/log.h>
+#include <util/string.h>
+#include <test/check.h>
+
+#include <ring_buffer.h>
+
+using namespace Genode;
+using Test::check;
+
+Genode::size_t Component::stack_size() { return 64*1024; }
+
+/* Ring element of the same size as a padded MI_BATCH_BUFFER_START */
+struct Job
+{
+	uint32_t header;
+	uint32_t address_ldw;
+	uint32_t address_udw;
+	uint32_t noop;
+
+	Job(uint32_t address = 0) : header(0x18800101), address_ldw(address), address_udw(0), noop(0) { }
+};
+
+/* Command twice the size of a job, used to force padding on wraparound */
+struct Double_job { Job first; Job second; };
+
+enum { RING_SIZE = 4096, SLOTS = RING_SIZE / sizeof(Job) };
+
+static uint8_t ring_mem[RING_SIZE];
+
+/**
+ * Consumer that advances the head like the command streamer would
+ */
+struct Simulated_gpu
+{
+	size_t   head = 0;
+	uint32_t next = 1;
+	bool     in_order = true;
+
+	/*
+	 * Consume at most 'count' jobs up to 'tail' and check that they appear
+	 * in the order they were appended. MI_NOOPs are skipped.
+	 */
+	void consume(size_t tail, unsigned count)
+	{
+		while (head != tail && count) {
+			Job const *job = (Job const *)(ring_mem + head);
+			head = (head + sizeof(Job)) % RING_SIZE;
+
+			if (job->header == 0)
+				continue;
+
+			if (job->address_ldw != next)
+				in_order = false;
+			next++;
+			count--;
+		}
+	}
+};
+
+void Component::construct(Genode::Env &env)
+{
+	bool ok = true;
+
+	log ("Submission ring test");
+
+	Ring_buffer   ring (ring_mem, RING_SIZE);
+	Simulated_gpu gpu;
+	uint32_t      job = 1;
+
+	/* Empty ring: one slot is always kept free */
+	ok &= check (ring.idle(), "new ring not idle");
+	ok &= check (ring.avail() == RING_SIZE - Ring_buffer::ALIGNMENT, "wrong initial space");
+
+	/* Fill the ring until back-pressure kicks in */
+	unsigned inserted = 0;
+	while (ring.append (Job (job))) { job++; inserted++; }
+	ok &= check (inserted == SLOTS - 1, "ring did not hold SLOTS - 1 jobs");
+	ok &= check (ring.published() == 0, "tail published before commit");
+
+	/* A whole batch is published with a single tail update */
+	size_t tail = ring.publish();
+	ok &= check (ring.pending() == 0, "pending jobs after publish");
+	ok &= check (tail == (SLOTS - 1) * sizeof(Job), "unexpected tail offset");
+
+	/* GPU consumes part of the jobs, producer wraps around */
+	gpu.consume (tail, 10);
+	ring.head (gpu.head);
+	ok &= check (!ring.idle(), "ring idle with outstanding jobs");
+
+	inserted = 0;
+	while (ring.append (Job (job))) { job++; inserted++; }
+	ok &= check (inserted == 10, "freed slots not reusable");
+	ok &= check (ring.tail() < ring.head(), "tail did not wrap around");
+	tail = ring.publish();
+
+	/* Drain the ring */
+	gpu.consume (tail, ~0U);
+	ring.head (gpu.head);
+	ok &= check (ring.idle(), "ring not idle after draining");
+
+	/* Commands that do not fit before the end are padded with MI_NOOP */
+	while (ring.tail() != RING_SIZE - sizeof(Job)) {
+		ring.append (Job (job++));
+		gpu.consume (ring.publish(), ~0U);
+		ring.head (gpu.head);
+	}
+
+	Double_job dj;
+	dj.first  = Job (job++);
+	dj.second = Job (job++);
+	ok &= check (ring.append (dj), "appending across the end failed");
+	ok &= check (ring.tail() == sizeof(Double_job), "command straddles end of ring");
+	gpu.consume (ring.publish(), ~0U);
+	ring.head (gpu.head);
+
+	ok &= check (ring.idle(), "ring not idle after padding");
+	ok &= check (gpu.in_order, "jobs consumed out of order");
+	ok &= check (gpu.next == job, "jobs lost");
+
+	if (!ok) {
+		error ("Submission ring test failed");
+		env.parent().exit(-1);
+		return;
+	}
+
+	log ("Done");
+	env.parent().exit(0);
+}
@@ -0,0 +1,6 @@
+TARGET = submission_ring
+SRC_CC = main.cc
+LIBS   = base
+
+# For ring_buffer.h
+INC_DIR += $(PRG_DIR)/../../app/hello_gpu